@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <random>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include "compile_settings.h"
+#include "metrics.hpp"
+#include "sha256.hpp"
+
+namespace fs = boost::filesystem;
+
+// 共享内存产物环：评测机与编译节点同主机时，产物写入 POSIX 共享内存段，结果中只携带段名
+// 段名为 /judge-artifact.<pid>.<随机串>.<序号>，评测机以 shm_open + mmap 只读映射，无需经过 broker 与磁盘；
+// 随机串区分共享 /dev/shm 的各容器（PID 都可能为 1），仍冲突时换名重试，最终失败则改走产物存储或内联
+// 段的生命周期：评测机读取后自行 shm_unlink，即为确认；未被确认的段在结果发出 ARTIFACT_SHM_TTL 后清理。
+// 经暂存延迟回送的结果以回送时间计时，暂存非空期间不清理。已发出的段从不为腾出空间而删除：
+// 段数或总字节数达到上限时新产物改走产物存储或内联。进程启动时接管已退出进程遗留的段，同样按 TTL 清理
+
+class ArtifactRing
+{
+private:
+    struct Segment
+    {
+        std::string name;
+        size_t size;
+        std::time_t created;
+    };
+
+    static constexpr const char *PREFIX = "judge-artifact.";
+    static constexpr const char *SHM_DIR = "/dev/shm";
+
+    bool on;
+    std::mutex mutex;
+    std::deque<Segment> segments; // 未确认的段，按写入顺序
+    size_t bytes = 0;
+    size_t budget;
+    std::string prefix; // /judge-artifact.<pid>.<随机串>.
+    uint64_t sequence = 0;
+
+    ArtifactRing(bool on) : on(on), budget(capacity())
+    {
+        std::random_device random;
+        char token[17];
+        snprintf(token, sizeof(token), "%08x%08x", random(), random());
+        prefix = "/" + std::string(PREFIX) + std::to_string(getpid()) + "." + token + ".";
+        if (on)
+            adopt();
+    }
+
+    /**
+     * @brief 总字节数上限：ARTIFACT_SHM_BYTES，且不超过 /dev/shm 容量的 3/4（容器默认仅 64 MB）
+     */
+    static size_t capacity()
+    {
+        size_t limit = ARTIFACT_SHM_BYTES;
+        struct statvfs vfs;
+        if (statvfs(SHM_DIR, &vfs) == 0)
+            limit = std::min<size_t>(limit, vfs.f_blocks * vfs.f_frsize / 4 * 3);
+        return limit;
+    }
+
+    /**
+     * @brief 接管已退出进程遗留的段：其结果可能仍在暂存中等待回送，或尚未被评测机读取
+     */
+    void adopt()
+    {
+        boost::system::error_code ec;
+        for (fs::directory_iterator itr(SHM_DIR, ec), end; !ec && itr != end; itr.increment(ec))
+        {
+            std::string name = itr->path().filename().string();
+            if (name.compare(0, strlen(PREFIX), PREFIX) != 0)
+                continue;
+            pid_t pid = atoi(name.c_str() + strlen(PREFIX));
+            if (pid <= 0 || pid == getpid() || kill(pid, 0) == 0)
+                continue;
+            Segment segment{"/" + name, (size_t)fs::file_size(itr->path(), ec), fs::last_write_time(itr->path(), ec)};
+            bytes += segment.size;
+            segments.push_back(segment);
+        }
+    }
+
+    /**
+     * @brief 从索引中移除写入失败的段
+     */
+    void discard(const std::string &name)
+    {
+        shm_unlink(name.c_str());
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = segments.begin(); it != segments.end(); it++)
+        {
+            if (it->name == name)
+            {
+                bytes -= it->size;
+                segments.erase(it);
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief 移除已被评测机确认（删除）的段（调用方持有锁）
+     */
+    void refresh()
+    {
+        for (auto it = segments.begin(); it != segments.end();)
+        {
+            if (access((SHM_DIR + it->name).c_str(), F_OK) == 0)
+            {
+                it++;
+                continue;
+            }
+            bytes -= it->size;
+            it = segments.erase(it);
+            Metrics::counter("artifact.shm_ack").add();
+        }
+    }
+
+public:
+    /**
+     * @brief 全局共享内存产物环，ARTIFACT_SHM 为 0 时不启用
+     */
+    static ArtifactRing &instance()
+    {
+        static ArtifactRing ring(getSetting("ARTIFACT_SHM", ARTIFACT_SHM) != 0);
+        return ring;
+    }
+
+    bool enabled() const
+    {
+        return on;
+    }
+
+    /**
+     * @brief 清理未被确认且超过 ARTIFACT_SHM_TTL 的段
+     * @param deferred 最近一次经暂存延迟回送结果的时间，之前写入的段从该时间起计时
+     */
+    void expire(std::time_t deferred)
+    {
+        if (!on)
+            return;
+        std::time_t deadline = std::time(nullptr) - getSetting("ARTIFACT_SHM_TTL", ARTIFACT_SHM_TTL);
+        std::lock_guard<std::mutex> lock(mutex);
+        refresh();
+        for (auto it = segments.begin(); it != segments.end();)
+        {
+            if (std::max(it->created, deferred) >= deadline)
+            {
+                it++;
+                continue;
+            }
+            shm_unlink(it->name.c_str());
+            bytes -= it->size;
+            it = segments.erase(it);
+            Metrics::counter("artifact.shm_expire").add();
+        }
+    }
+
+    /**
+     * @brief 把文件写入新的共享内存段
+     * @param filePath 产物路径
+     * @return 句柄 {"shm": 段名, "size": 字节数, "hash": sha256}；段数或字节数已达上限、创建或写入失败时返回 null
+     */
+    json put(const fs::path &filePath)
+    {
+        int in = open(filePath.c_str(), O_RDONLY);
+        if (in == -1)
+            throw std::runtime_error("Cannot open file for reading");
+        struct stat st;
+        fstat(in, &st);
+        size_t size = st.st_size;
+
+        std::string name;
+        int fd = -1;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t slots = getSetting("ARTIFACT_SHM_SLOTS", ARTIFACT_SHM_SLOTS);
+            if (segments.size() >= slots || bytes + size > budget)
+                refresh();
+            if (segments.size() >= slots || bytes + size > budget)
+            { // 不删除尚未确认的段，改走其他方式
+                close(in);
+                Metrics::counter("artifact.shm_full").add();
+                return json();
+            }
+            for (int attempt = 0; fd == -1 && attempt < 3; attempt++)
+            { // 段名已被占用时换下一个序号
+                name = prefix + std::to_string(sequence++);
+                fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+                if (fd == -1 && errno != EEXIST)
+                    break;
+            }
+            if (fd == -1)
+            {
+                close(in);
+                Metrics::counter("artifact.shm_fail").add();
+                return json();
+            }
+            segments.push_back({name, size, std::time(nullptr)});
+            bytes += size;
+        }
+
+        Sha256 sha;
+        bool ok = ftruncate(fd, size) == 0;
+        if (ok && size > 0)
+        { // 直接读入映射区，不经过中间缓冲，读取的同时计算哈希（需可读）
+            void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ok = addr != MAP_FAILED;
+            for (size_t done = 0; ok && done < size;)
+            {
+                ssize_t n = read(in, static_cast<char *>(addr) + done, size - done);
+                ok = n > 0;
+                if (ok)
+                    sha.update(static_cast<char *>(addr) + done, n);
+                done += ok ? n : 0;
+            }
+            if (addr != MAP_FAILED)
+                munmap(addr, size);
+        }
+        close(fd);
+        close(in);
+        if (!ok)
+        { // /dev/shm 空间不足等，改走其他方式
+            discard(name);
+            Metrics::counter("artifact.shm_fail").add();
+            return json();
+        }
+
+        Metrics::counter("artifact.shm_put").add();
+        return {{"shm", name}, {"size", size}, {"hash", sha.hex()}};
+    }
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "compile_settings.h"
+#include "metrics.hpp"
+#include "sha256.hpp"
+
+namespace fs = boost::filesystem;
+
+// 产物存储：与评测机共享文件系统时，产物按内容哈希保存到 ARTIFACT_STORE_ROOT，结果中只携带引用
+// 布局：<root>/<哈希前两位>/<sha256>，先写入 <root>/tmp（mkstemp 生成唯一名，多节点共享不冲突）再原子改名；
+// 相同内容只保留一份。超过 ARTIFACT_STORE_TTL 未被再次写入的文件由 expire() 清理，每个节点都会执行：
+// 清理时先把文件移入 tmp 再复查时间，期间被 put() 刷新的移回原处；put() 刷新后复查文件仍在，否则写入自己的副本
+
+class ArtifactStore
+{
+private:
+    fs::path root;
+
+    ArtifactStore(const std::string &root) : root(root)
+    {
+        if (!root.empty())
+            fs::create_directories(this->root / "tmp");
+    }
+
+public:
+    /**
+     * @brief 全局产物存储，ARTIFACT_STORE_ROOT 为空时不启用
+     */
+    static ArtifactStore &instance()
+    {
+        static ArtifactStore store(getSetting("ARTIFACT_STORE_ROOT", ARTIFACT_STORE_ROOT));
+        return store;
+    }
+
+    bool enabled() const
+    {
+        return !root.empty();
+    }
+
+    /**
+     * @brief 保存文件，读取时同时计算哈希
+     * @param filePath 产物路径
+     * @return 引用 {"hash": sha256, "size": 字节数, "path": 存储路径}
+     */
+    json put(const fs::path &filePath)
+    {
+        std::ifstream in(filePath.string(), std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Cannot open file for reading");
+
+        fs::path tmp = temporary();
+        std::ofstream out(tmp.string(), std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Cannot open file for writing");
+
+        Sha256 sha;
+        uint64_t size = 0;
+        char buffer[64 * 1024];
+        while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0)
+        {
+            sha.update(buffer, in.gcount());
+            out.write(buffer, in.gcount());
+            size += in.gcount();
+        }
+        out.close();
+        if (!out)
+        {
+            fs::remove(tmp);
+            throw std::runtime_error("Artifact write failed");
+        }
+
+        std::string hash = sha.hex();
+        fs::path target = root / hash.substr(0, 2) / hash;
+        fs::create_directories(target.parent_path());
+        boost::system::error_code ec;
+        // 内容相同，刷新时间以延后清理；刷新后复查，文件已被其他节点清理时写入本地副本
+        fs::last_write_time(target, std::time(nullptr), ec);
+        if (!ec && fs::exists(target, ec))
+        {
+            fs::remove(tmp, ec);
+            Metrics::counter("artifact.dedup").add();
+        }
+        else
+            fs::rename(tmp, target);
+
+        Metrics::counter("artifact.put").add();
+        Metrics::summary("artifact.size").record(size);
+        return {{"hash", hash}, {"size", size}, {"path", target.string()}};
+    }
+
+    /**
+     * @brief 清理超过 ARTIFACT_STORE_TTL 的文件
+     * 产物先移入 tmp 再复查修改时间：移动前被 put() 刷新的移回原处，移动后 put() 会发现文件缺失并写入副本
+     */
+    void expire()
+    {
+        if (!enabled())
+            return;
+        std::time_t deadline = std::time(nullptr) - getSetting("ARTIFACT_STORE_TTL", ARTIFACT_STORE_TTL);
+        fs::path tmpDir = root / "tmp";
+        std::vector<fs::path> expired;
+        boost::system::error_code ec;
+        for (fs::recursive_directory_iterator itr(root, ec), end; !ec && itr != end; itr.increment(ec))
+        {
+            if (fs::is_regular_file(itr->path(), ec) && fs::last_write_time(itr->path(), ec) < deadline)
+                expired.push_back(itr->path());
+        }
+
+        for (auto &path : expired)
+        {
+            if (path.parent_path() == tmpDir)
+            { // 中断写入留下的临时文件
+                fs::remove(path, ec);
+                continue;
+            }
+            fs::path grave;
+            try
+            {
+                grave = temporary();
+            }
+            catch (const std::exception &)
+            { // 临时目录不可写，下次再清理
+                return;
+            }
+            fs::rename(path, grave, ec);
+            if (ec)
+            { // 已被其他节点清理
+                fs::remove(grave, ec);
+                continue;
+            }
+            if (fs::last_write_time(grave, ec) >= deadline && !fs::exists(path))
+            { // 移动前刚被 put() 刷新
+                fs::rename(grave, path, ec);
+                continue;
+            }
+            fs::remove(grave, ec);
+            Metrics::counter("artifact.expire").add();
+        }
+    }
+
+private:
+    /**
+     * @brief 在 tmp 下创建唯一的临时文件（各节点即使 PID 相同也不冲突）
+     */
+    fs::path temporary()
+    {
+        std::string pattern = (root / "tmp" / "XXXXXX").string();
+        int fd = mkstemp(&pattern[0]);
+        if (fd == -1)
+            throw std::runtime_error("Cannot create temporary artifact");
+        close(fd);
+        return pattern;
+    }
+};
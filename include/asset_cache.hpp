@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "compile_settings.h"
+#include "metrics.hpp"
+
+namespace fs = boost::filesystem;
+
+// 题目附加文件缓存：解码后的 extra 文件按 sha256 保存在 FILE_ROOT_PATH/ASSET_CACHE_DIR/<哈希前两位>/<sha256>
+// 任务中的 extra 可以内联（base64 / 原始字节），也可以只给出引用 {"文件名": {"sha256": 哈希}}；
+// 引用命中时以 reflink（写时复制）放入任务目录，文件系统不支持时退回复制；内联的文件在保存后加入缓存
+// 不使用硬链接：编译以 root 运行时只读权限不起作用，改写任务目录中的文件会直接改坏缓存
+// 缺失的哈希以 MISSING_ASSETS 状态回报，上游以内联方式补发后即可命中
+
+class AssetCache
+{
+private:
+    fs::path dir;
+    std::atomic<uint64_t> sequence{0};
+
+    AssetCache() : dir(fs::path(FILE_ROOT_PATH) / ASSET_CACHE_DIR)
+    {
+        fs::create_directories(dir / "tmp");
+    }
+
+    /**
+     * @brief 哈希可作为文件名时返回缓存路径，否则返回空路径
+     */
+    fs::path pathOf(const std::string &hash) const
+    {
+        if (hash.size() != 64 || hash.find_first_not_of("0123456789abcdef") != std::string::npos)
+            return fs::path();
+        return dir / hash.substr(0, 2) / hash;
+    }
+
+    /**
+     * @brief reflink 复制，文件系统不支持时返回 false
+     */
+    static bool clone(const fs::path &from, const fs::path &to)
+    {
+        int in = open(from.c_str(), O_RDONLY);
+        if (in == -1)
+            return false;
+        int out = open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        bool ok = out != -1 && ioctl(out, FICLONE, in) == 0;
+        if (out != -1)
+            close(out);
+        close(in);
+        if (!ok && out != -1)
+            unlink(to.c_str());
+        return ok;
+    }
+
+public:
+    static AssetCache &instance()
+    {
+        static AssetCache cache;
+        return cache;
+    }
+
+    /**
+     * @brief extra 条目的值是否为哈希引用
+     */
+    static bool isReference(const json &value)
+    {
+        return value.is_object() && value.contains("sha256");
+    }
+
+    /**
+     * @brief 把缓存中的文件放入任务目录
+     * @param hash 内容哈希
+     * @param filePath 目标路径
+     * @return 未命中返回 false
+     */
+    bool link(const std::string &hash, const fs::path &filePath)
+    {
+        fs::path cached = pathOf(hash);
+        boost::system::error_code ec;
+        if (cached.empty() || !fs::exists(cached, ec))
+        {
+            Metrics::counter("asset.miss").add();
+            return false;
+        }
+        if (!clone(cached, filePath))
+            fs::copy_file(cached, filePath, fs::copy_options::overwrite_existing);
+        fs::last_write_time(cached, std::time(nullptr), ec); // 刷新时间以延后清理
+        Metrics::counter("asset.hit").add();
+        return true;
+    }
+
+    /**
+     * @brief 把已写入任务目录的文件加入缓存，已存在时跳过
+     * @param hash 内容哈希
+     * @param filePath 文件路径
+     */
+    void add(const std::string &hash, const fs::path &filePath)
+    {
+        fs::path cached = pathOf(hash);
+        boost::system::error_code ec;
+        if (cached.empty() || fs::exists(cached, ec))
+            return;
+
+        // 先复制到临时文件再原子改名，任务目录中的文件随后会被删除或改写，不与其共享 inode
+        fs::path tmp = dir / "tmp" / (std::to_string(getpid()) + "." + std::to_string(sequence++));
+        fs::copy_file(filePath, tmp, fs::copy_options::overwrite_existing, ec);
+        if (!ec)
+        {
+            fs::permissions(tmp, fs::owner_read | fs::group_read | fs::others_read, ec);
+            fs::create_directories(cached.parent_path(), ec);
+            fs::rename(tmp, cached, ec);
+        }
+        if (ec)
+        {
+            fs::remove(tmp, ec);
+            return;
+        }
+        Metrics::counter("asset.add").add();
+    }
+
+    /**
+     * @brief 清理超过 ASSET_CACHE_TTL 未被使用的文件
+     */
+    void expire()
+    {
+        std::time_t deadline = std::time(nullptr) - getSetting("ASSET_CACHE_TTL", ASSET_CACHE_TTL);
+        boost::system::error_code ec;
+        for (fs::recursive_directory_iterator itr(dir, ec), end; !ec && itr != end; itr.increment(ec))
+        {
+            if (fs::is_regular_file(itr->path(), ec) && fs::last_write_time(itr->path(), ec) < deadline)
+                fs::remove(itr->path(), ec);
+        }
+    }
+};
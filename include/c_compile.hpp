@@ -5,6 +5,7 @@
 #include <sys/wait.h>
 
 #include "compile_settings.h"
+#include "compile_cache.hpp"
 #include "compile_interface.h"
 #include "file_methods.hpp"
 
@@ -55,28 +56,41 @@ public:
         answerFile << answer["code"].get<std::string>();
     }
 
-    void compile() override
+    /**
+     * @brief gcc参数
+     */
+    std::vector<std::string> compileArgs()
     {
         json extra = taskData["extra"];
 
-        // gcc参数
-        std::vector<const char *> args;
-        args.push_back("gcc");
-        args.push_back("-o");
-        args.push_back("main");
-        args.push_back("main.c");
+        std::vector<std::string> args = {"gcc", "-o", "main", "main.c"};
         for (auto &item : extra.items())
         {
             std::string key = item.key();
             std::string suffix = key.substr(key.find_last_of('.') + 1);
             if (suffix == "c")
             {
-                args.push_back(key.c_str());
+                args.push_back(key);
             }
         }
         args.push_back("-std=c11");
         args.push_back("-lm");
-        args.push_back(nullptr);
+        return args;
+    }
+
+    std::string signature() override
+    {
+        return CompileCache::signature(compileArgs(), CompileCache::toolchainVersion("gcc"));
+    }
+
+    void compile() override
+    {
+        // gcc参数
+        std::vector<std::string> argList = compileArgs();
+        std::vector<const char *> args;
+        for (auto &arg : argList)
+            args.push_back(arg.c_str());
+        args.push_back(nullptr); // execvp 要求以 nullptr 结尾
 
         // 创建管道
         int pipefd[2];
@@ -94,6 +108,7 @@ public:
         }
         else if (pid == 0)
         {                     // 子进程
+            setpgid(0, 0);    // 自立进程组，取消时连同编译器派生的进程一并终止
             close(pipefd[0]); // 关闭读端
             dup2(pipefd[1], STDERR_FILENO);
             close(pipefd[1]);
@@ -114,9 +129,10 @@ public:
         else if (pid > 0)
         {                     // 父进程
             close(pipefd[1]); // 关闭写端
+            trackChild(pid);  // 登记子进程，取消时由 cancel() 终止
 
             int status;
-            waitpid(pid, &status, 0); // 等待子进程结束
+            waitChild(pid, status); // 等待子进程结束
 
             // 读取错误信息
             char buffer[1024];
@@ -127,6 +143,7 @@ public:
             }
             close(pipefd[0]);
 
+            checkCancelled();
             if (!compileError.empty())
             { // 编译器报错
                 throw compile_error(compileError);
@@ -148,11 +165,7 @@ public:
         {
             throw std::runtime_error("File not exists");
         }
-        std::string base64str;
-        Base64::EncodeFileToBase64(mainPath, base64str);
-        // 放入TaskData.task.result
-        json result;
-        result["main"] = base64str;
-        taskData["task"]["result"].push_back(result);
+        // 放入TaskData.task.result，哈希与大小记入TaskData.task.resultMeta
+        addResult(taskData, "main", mainPath);
     }
 };
\ No newline at end of file
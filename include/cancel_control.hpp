@@ -0,0 +1,172 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "compile_interface.h"
+#include "rabbitmq_worker.hpp"
+#include "metrics.hpp"
+
+// 任务取消：控制通道收到的取消请求登记在 CancelRegistry 中，
+// 尚在线程池队列中的任务开始处理时直接以 CANCELLED 结果返回，正在编译的任务终止其编译子进程
+// 取消只作用于取消之前收到的投递：之后收到的同 ID 投递（如重判）开始处理时清除取消记录
+
+class CancelRegistry
+{
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> cancelled; // taskID -> 取消时间
+    std::unordered_map<std::string, CompileInterface *> running; // 正在处理的任务
+
+    /**
+     * @brief 清理过期的取消记录
+     */
+    void expire()
+    {
+        auto deadline = std::chrono::steady_clock::now() - std::chrono::seconds(CANCEL_TTL);
+        for (auto it = cancelled.begin(); it != cancelled.end();)
+        {
+            if (it->second < deadline)
+                it = cancelled.erase(it);
+            else
+                it++;
+        }
+    }
+
+public:
+    CancelRegistry() {};
+
+    ~CancelRegistry() {};
+
+    static CancelRegistry &instance()
+    {
+        static CancelRegistry registry;
+        return registry;
+    }
+
+    /**
+     * @brief 取消任务：登记取消记录，正在处理的任务立即终止编译
+     */
+    void cancel(const std::string &taskID)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cancelled.size() >= 1024)
+            expire();
+        cancelled[taskID] = std::chrono::steady_clock::now();
+        auto it = running.find(taskID);
+        if (it != running.end())
+            it->second->cancel();
+        Metrics::counter("cancel.request").add();
+    }
+
+    bool isCancelled(const std::string &taskID)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cancelled.find(taskID);
+        return it != cancelled.end() && it->second >= std::chrono::steady_clock::now() - std::chrono::seconds(CANCEL_TTL);
+    }
+
+    /**
+     * @brief 同 ID 的新投递开始处理：投递在取消之后才收到时清除取消记录，不受先前的取消影响
+     * @param received 投递的接收时间
+     */
+    void admit(const std::string &taskID, std::chrono::steady_clock::time_point received)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cancelled.find(taskID);
+        if (it != cancelled.end() && it->second < received)
+            cancelled.erase(it);
+    }
+
+    /**
+     * @brief 登记正在处理的任务；登记前已被取消的立即取消
+     */
+    void attach(const std::string &taskID, CompileInterface *compileImpl)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running[taskID] = compileImpl;
+        if (cancelled.count(taskID))
+            compileImpl->cancel();
+    }
+
+    void detach(const std::string &taskID)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running.erase(taskID);
+    }
+};
+
+class ControlListener
+{
+private:
+    std::atomic<bool> running{true};
+    std::thread worker;
+
+    /**
+     * @brief 处理一条控制消息，形如 {"cancel": ["taskID", ...]} 或 {"cancel": "taskID"}
+     */
+    static void handle(const std::string &body)
+    {
+        json control = json::parse(body);
+        json ids = control["cancel"];
+        if (ids.is_string())
+            ids = json::array({ids});
+        for (auto &id : ids)
+        {
+            if (!id.is_string())
+                continue;
+            std::cout << getCurrentTime() << "Cancel Task: " << id.get<std::string>() << std::endl;
+            CancelRegistry::instance().cancel(id);
+        }
+    }
+
+    void run()
+    {
+        Backoff backoff;
+        while (running)
+        {
+            try
+            {
+                // 每个节点一个临时队列，绑定到 fanout 交换机以收到全部控制消息
+                Channel::ptr_t channel = Channel::Create(MQ_HOST, MQ_PORT, MQ_USER, MQ_PASSWORD);
+                channel->DeclareExchange(CONTROL_EXCHANGE, Channel::EXCHANGE_TYPE_FANOUT, false, true, false);
+                std::string queue = channel->DeclareQueue("", false, false, true, true);
+                channel->BindQueue(queue, CONTROL_EXCHANGE, "");
+                std::string tag = channel->BasicConsume(queue, "", true, true /* no_ack */, true /* exclusive */);
+                backoff = Backoff();
+
+                while (running)
+                {
+                    Envelope::ptr_t envelope;
+                    if (!channel->BasicConsumeMessage(tag, envelope, MQ_CONSUME_TIMEOUT))
+                        continue;
+                    try
+                    {
+                        handle(envelope->Message()->Body());
+                    }
+                    catch (const json::exception &e)
+                    {
+                        std::cerr << getCurrentTime() << "Drop malformed control message: " << e.what() << std::endl;
+                    }
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << getCurrentTime() << "Control channel lost: " << e.what() << std::endl;
+                backoff.wait();
+            }
+        }
+    }
+
+public:
+    ControlListener() : worker(&ControlListener::run, this) {}
+
+    ~ControlListener()
+    {
+        running = false;
+        worker.join();
+    }
+};
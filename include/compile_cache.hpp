@@ -0,0 +1,279 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "asset_cache.hpp"
+#include "compile_settings.h"
+#include "metrics.hpp"
+#include "sha256.hpp"
+
+namespace fs = boost::filesystem;
+
+// 编译缓存：以 (编译签名, 答案代码, 附加文件) 的 sha256 为键，保存编译后任务目录中的文件
+// 编译签名由各语言的 signature() 给出：编译器参数与工具链版本；为空的语言（解释型）不缓存
+// 命中时跳过 save() 与 compile()，把缓存的产物放入任务目录后照常 transcode()
+// 布局：FILE_ROOT_PATH/COMPILE_CACHE_DIR/<键>/ 下为产物文件，先写入临时目录再原子改名；
+// 总大小超出 COMPILE_CACHE_BYTES 时按最近使用时间（目录 mtime）淘汰
+
+class CompileCache
+{
+private:
+    struct Entry
+    {
+        uint64_t size;
+        std::time_t used;
+    };
+
+    fs::path dir;
+    std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    uint64_t total = 0;
+    uint64_t sequence = 0;
+
+    CompileCache() : dir(fs::path(FILE_ROOT_PATH) / COMPILE_CACHE_DIR)
+    {
+        fs::create_directories(dir);
+        // 载入已有条目，清理中断的临时目录
+        boost::system::error_code ec;
+        for (fs::directory_iterator itr(dir, ec), end; !ec && itr != end; itr.increment(ec))
+        {
+            std::string name = itr->path().filename().string();
+            if (name.find('.') != std::string::npos)
+            {
+                fs::remove_all(itr->path(), ec);
+                continue;
+            }
+            Entry entry{sizeOf(itr->path()), fs::last_write_time(itr->path(), ec)};
+            entries[name] = entry;
+            total += entry.size;
+        }
+    }
+
+    static uint64_t sizeOf(const fs::path &entryDir)
+    {
+        uint64_t size = 0;
+        boost::system::error_code ec;
+        for (fs::directory_iterator itr(entryDir, ec), end; !ec && itr != end; itr.increment(ec))
+            size += fs::file_size(itr->path(), ec);
+        return size;
+    }
+
+    /**
+     * @brief 淘汰最久未使用的条目直至不超出容量（调用方持有锁）
+     */
+    void evict()
+    {
+        uint64_t budget = getSetting("COMPILE_CACHE_BYTES", COMPILE_CACHE_BYTES);
+        while (total > budget && !entries.empty())
+        {
+            auto oldest = entries.begin();
+            for (auto it = entries.begin(); it != entries.end(); it++)
+            {
+                if (it->second.used < oldest->second.used)
+                    oldest = it;
+            }
+            boost::system::error_code ec;
+            fs::remove_all(dir / oldest->first, ec);
+            total -= oldest->second.size;
+            entries.erase(oldest);
+            Metrics::counter("compile_cache.evict").add();
+        }
+    }
+
+public:
+    static CompileCache &instance()
+    {
+        static CompileCache cache;
+        return cache;
+    }
+
+    /**
+     * @brief 工具链版本：命令 --version 输出的第一行，每个命令只查询一次
+     * @param command 编译器命令
+     * @param flag 版本参数
+     */
+    static std::string toolchainVersion(const std::string &command, const std::string &flag = "--version")
+    {
+        static std::mutex versionMutex;
+        static std::map<std::string, std::string> versions;
+        std::lock_guard<std::mutex> lock(versionMutex);
+        auto it = versions.find(command);
+        if (it != versions.end())
+            return it->second;
+
+        std::string version;
+        FILE *pipe = popen((command + " " + flag + " 2>&1").c_str(), "r");
+        if (pipe != nullptr)
+        {
+            char buffer[256];
+            if (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+                version = buffer;
+            pclose(pipe);
+        }
+        return versions[command] = version;
+    }
+
+    /**
+     * @brief 由编译器参数与工具链版本生成编译签名
+     */
+    static std::string signature(const std::vector<std::string> &args, const std::string &version)
+    {
+        std::string sig = version;
+        for (auto &arg : args)
+        {
+            sig += '\0';
+            sig += arg;
+        }
+        return sig;
+    }
+
+    /**
+     * @brief 计算缓存键
+     * @param taskData 任务数据
+     * @param signature 编译签名，为空时不缓存
+     * @return 缓存键，不缓存时为空
+     */
+    static std::string key(json &taskData, const std::string &signature)
+    {
+        if (signature.empty() || getSetting("COMPILE_CACHE_BYTES", COMPILE_CACHE_BYTES) <= 0)
+            return "";
+
+        Sha256 sha;
+        sha.update(signature);
+        sha.update("\0code\0", 6);
+        sha.update(taskData["task"]["answer"]["code"].get_ref<const std::string &>());
+        for (auto &element : taskData["extra"])
+        {
+            for (auto &item : element.items())
+            {
+                sha.update("\0extra\0", 7);
+                sha.update(item.key());
+                sha.update("\0", 1);
+                const json &value = item.value();
+                if (AssetCache::isReference(value))
+                    sha.update("sha256:" + value["sha256"].get<std::string>());
+                else if (value.is_binary())
+                    sha.update(value.get_binary().data(), value.get_binary().size());
+                else
+                    sha.update(value.get<std::string>());
+            }
+        }
+        return sha.hex();
+    }
+
+    /**
+     * @brief 列出目录中的文件名
+     */
+    static std::set<std::string> listFiles(const fs::path &path)
+    {
+        std::set<std::string> files;
+        boost::system::error_code ec;
+        for (fs::directory_iterator itr(path, ec), end; !ec && itr != end; itr.increment(ec))
+        {
+            if (fs::is_regular_file(itr->path(), ec))
+                files.insert(itr->path().filename().string());
+        }
+        return files;
+    }
+
+    /**
+     * @brief 命中时把缓存的文件放入任务目录：先复制到任务目录下的暂存目录，全部成功后再逐个改名，
+     *        失败时不在任务目录中留下部分文件
+     * @return 是否命中
+     */
+    bool restore(const std::string &key, const fs::path &taskDir)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it == entries.end())
+            {
+                Metrics::counter("compile_cache.miss").add();
+                return false;
+            }
+            it->second.used = std::time(nullptr);
+        }
+
+        boost::system::error_code ec;
+        fs::path entryDir = dir / key;
+        fs::path staging = taskDir / ".restore";
+        fs::last_write_time(entryDir, std::time(nullptr), ec);
+        std::set<std::string> names = listFiles(entryDir);
+        fs::create_directory(staging, ec);
+        for (auto &name : names)
+        {
+            if (ec)
+                break;
+            fs::copy_file(entryDir / name, staging / name, ec);
+        }
+
+        std::vector<std::string> moved;
+        if (!ec && !names.empty())
+        {
+            for (auto &name : names)
+            {
+                fs::rename(staging / name, taskDir / name, ec);
+                if (ec)
+                    break;
+                moved.push_back(name);
+            }
+        }
+        bool hit = !ec && !names.empty();
+        if (!hit)
+        { // 条目已被其他线程淘汰，或复制失败：撤回已放入的文件
+            for (auto &name : moved)
+                fs::remove(taskDir / name, ec);
+        }
+        fs::remove_all(staging, ec);
+        Metrics::counter(hit ? "compile_cache.hit" : "compile_cache.miss").add();
+        return hit;
+    }
+
+    /**
+     * @brief 保存编译后任务目录中的文件（含 save() 写入的源文件与附加文件），命中时的目录与编译后一致
+     * @param key 缓存键
+     * @param taskDir 任务目录
+     */
+    void store(const std::string &key, const fs::path &taskDir)
+    {
+        fs::path tmp;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (entries.count(key))
+                return;
+            tmp = dir / (key + "." + std::to_string(getpid()) + "." + std::to_string(sequence++));
+        }
+
+        boost::system::error_code ec;
+        fs::create_directories(tmp, ec);
+        uint64_t size = 0;
+        for (auto &name : listFiles(taskDir))
+        {
+            if (ec)
+                break;
+            fs::copy_file(taskDir / name, tmp / name, ec);
+            size += fs::file_size(tmp / name, ec);
+        }
+        if (!ec)
+            fs::rename(tmp, dir / key, ec);
+        if (ec)
+        { // 同键已由其他线程写入，或写入失败
+            fs::remove_all(tmp, ec);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        entries[key] = {size, std::time(nullptr)};
+        total += size;
+        evict();
+        Metrics::counter("compile_cache.store").add();
+    }
+};
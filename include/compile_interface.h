@@ -1,10 +1,142 @@
 #pragma once
 
+#include <atomic>
+#include <cerrno>
+#include <map>
+#include <mutex>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "artifact_ring.hpp"
+#include "artifact_store.hpp"
+#include "asset_cache.hpp"
 #include "compile_settings.h"
 #include "file_methods.hpp"
+#include "sha256.hpp"
 
 class CompileInterface
 {
+protected:
+    // 正在运行的编译子进程，同时是其进程组 ID；子进程被回收前清零，cancel() 不会误杀复用的 PID
+    pid_t childPid = 0;
+    std::mutex childMutex;
+    std::atomic<bool> cancelled{false};
+    bool binary = false; // 产物以原始字节（json::binary）回送，否则为 base64 字符串
+    std::map<std::string, json> extraMeta; // saveFromJsonList() 保存附加文件时记下的哈希与大小，按文件名索引
+
+    /**
+     * @brief 登记编译子进程，任务已取消时立即终止
+     * 子进程在 exec 前以 setpgid(0, 0) 自立进程组，这里再设置一次以免取消先于子进程设置；
+     * 取消时终止整个进程组（cc1plus / as / ld、JVM 等）
+     */
+    void trackChild(pid_t pid)
+    {
+        setpgid(pid, pid);
+        std::lock_guard<std::mutex> lock(childMutex);
+        childPid = pid;
+        if (cancelled)
+            kill(-pid, SIGKILL);
+    }
+
+    /**
+     * @brief 等待编译子进程结束：先以 WNOWAIT 等待（子进程保持僵尸状态，PID 不会被复用），
+     *        撤销登记后再回收
+     * @param status 输出子进程的退出状态
+     */
+    void waitChild(pid_t pid, int &status)
+    {
+        siginfo_t info;
+        while (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == -1 && errno == EINTR)
+            ;
+        {
+            std::lock_guard<std::mutex> lock(childMutex);
+            childPid = 0;
+        }
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR)
+            ;
+    }
+
+    /**
+     * @brief 读取产物文件，按回送格式编码：启用共享内存或产物存储时为句柄 / 引用（共享内存已满时改用后者），
+     *        否则为原始字节或 base64 字符串
+     * @param meta 输出 {"sha256": 内容哈希, "size": 字节数}，在读取文件的同一遍中计算
+     */
+    json encodeFile(const fs::path &filePath, json &meta)
+    {
+        json value;
+        if (ArtifactRing::instance().enabled())
+            value = ArtifactRing::instance().put(filePath);
+        if (value.is_null() && ArtifactStore::instance().enabled())
+            value = ArtifactStore::instance().put(filePath);
+        if (!value.is_null())
+        {
+            meta = {{"sha256", value["hash"]}, {"size", value["size"]}};
+            return value;
+        }
+
+        // 文件只读入一次，编码结果直接移入 DOM
+        if (binary)
+        {
+            std::vector<std::uint8_t> bytes;
+            BinaryFile::ReadFile(filePath, bytes);
+            meta = describe(bytes.data(), bytes.size());
+            return json::binary(std::move(bytes));
+        }
+        std::string content, base64str;
+        BinaryFile::ReadFile(filePath, content);
+        meta = describe(content.data(), content.size());
+        Base64::EncodeToBase64(content, base64str);
+        return json(std::move(base64str));
+    }
+
+    /**
+     * @brief 内容的哈希与大小
+     */
+    static json describe(const void *data, size_t size)
+    {
+        Sha256 sha;
+        sha.update(data, size);
+        return {{"sha256", sha.hex()}, {"size", size}};
+    }
+
+    /**
+     * @brief 把附加文件转回 task.result：内联的原样转回，哈希引用的从任务目录读取后编码；
+     *        哈希与大小记入 task.resultMeta（内联的沿用 save() 保存时算得的哈希，不再读盘）
+     * @param taskData 任务数据
+     * @param dirPath 任务目录
+     */
+    void forwardExtra(json &taskData, const fs::path &dirPath)
+    {
+        for (auto &element : taskData["extra"])
+        {
+            auto item = element.begin();
+            if (item == element.end())
+                continue;
+            if (AssetCache::isReference(item.value()))
+            { // 下游不一定有该缓存，按产物回送
+                addResult(taskData, item.key(), dirPath / item.key());
+                continue;
+            }
+            taskData["task"]["result"].push_back(element);
+            taskData["task"]["resultMeta"][item.key()] = extraMeta.at(item.key());
+        }
+    }
+
+    /**
+     * @brief 把产物追加到 task.result，并在 task.resultMeta 中记录其哈希与大小
+     * resultMeta 以文件名为键，与 result 分开存放，按首个键读取结果条目的旧消费端不受影响
+     * @param taskData 任务数据
+     * @param name 文件名
+     * @param filePath 产物路径
+     */
+    void addResult(json &taskData, const std::string &name, const fs::path &filePath)
+    {
+        json result, meta;
+        result[name] = encodeFile(filePath, meta);
+        taskData["task"]["result"].push_back(std::move(result));
+        taskData["task"]["resultMeta"][name] = std::move(meta);
+    }
+
 public:
     // 发生错误抛出异常
 
@@ -23,10 +155,50 @@ public:
      */
     virtual void transcode() = 0;
 
+    /**
+     * @brief 编译签名：编译器参数与工具链版本，作为编译缓存键的一部分（非必须）
+     * @return 为空时不缓存
+     */
+    virtual std::string signature()
+    {
+        return "";
+    }
+
     virtual ~CompileInterface() {};
 
+    /**
+     * @brief 取消任务（线程安全），终止正在运行的编译子进程
+     */
+    void cancel()
+    {
+        cancelled = true;
+        std::lock_guard<std::mutex> lock(childMutex);
+        if (childPid > 0)
+            kill(-childPid, SIGKILL);
+    }
+
+    /**
+     * @brief 设置产物的回送格式
+     * @param raw 为 true 时以原始字节回送（CBOR / MessagePack 封装）
+     */
+    void setBinary(bool raw)
+    {
+        binary = raw;
+    }
+
+    /**
+     * @brief 任务已取消时抛出 task_cancelled
+     */
+    void checkCancelled()
+    {
+        if (cancelled)
+            throw task_cancelled();
+    }
+
     /**
      * @brief 向指定目录下保存文件
+     * 元素为 {"文件名": base64 字符串 | 原始字节 | {"sha256": 哈希}}；
+     * 内联的文件保存后加入附加文件缓存，哈希引用从缓存取出，缓存缺失时抛出 assets_missing
      * @param list Json List
      * @param dirPath 父目录
      */
@@ -35,6 +207,7 @@ public:
         if (!list.is_array())
             throw std::runtime_error("wrong json type: not array");
 
+        std::vector<std::string> missing;
         for (auto &element : list)
         {
             if (!element.is_object())
@@ -45,10 +218,32 @@ public:
                 throw std::runtime_error("array element has no key-value pair");
 
             std::string key = item.key();
-            std::string value = item.value();
-
             fs::path filePath(dirPath / key);
-            Base64::DecodeBase64ToFile(value, filePath);
+            if (AssetCache::isReference(item.value()))
+            {
+                std::string hash = item.value()["sha256"];
+                if (!AssetCache::instance().link(hash, filePath))
+                    missing.push_back(hash);
+                else
+                    extraMeta[key] = {{"sha256", hash}, {"size", fs::file_size(filePath)}};
+                continue;
+            }
+
+            // 二进制封装中为原始字节，JSON 中为 base64 字符串
+            std::string content;
+            if (item.value().is_binary())
+            {
+                auto &bytes = item.value().get_binary();
+                content.assign(bytes.begin(), bytes.end());
+            }
+            else
+                Base64::DecodeFromBase64(item.value().get<std::string>(), content);
+            BinaryFile::WriteFile(content.data(), content.size(), filePath);
+            std::string hash = Sha256::of(content);
+            AssetCache::instance().add(hash, filePath);
+            extraMeta[key] = {{"sha256", hash}, {"size", content.size()}};
         }
+        if (!missing.empty())
+            throw assets_missing(std::move(missing));
     }
 };
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "metrics.hpp"
+#include "unix_socket.hpp"
+
+// 同步编译接口：同主机的调用方（评测机、IDE 后端）经 Unix 域套接字直接提交任务，不经过 broker
+// 每个连接独占一个线程，按序处理：请求帧为任务 JSON，应答帧为结果 JSON（与 CompileQueueOutput 中的结果相同）
+// 任务由 handler 交给共享的工作线程池执行，连接线程阻塞等待结果
+
+class CompileServer
+{
+public:
+    typedef std::function<std::string(std::string &&request)> Handler;
+
+private:
+    std::string path;
+    ino_t inode; // 本进程创建的套接字文件
+    int listenFd;
+    Handler handler;
+    std::atomic<bool> running{true};
+    std::mutex conn_mutex;
+    std::set<int> connections; // 活动连接，退出时关闭读端
+    std::thread acceptor;
+
+    void serve(int fd)
+    {
+        std::string request;
+        while (running && UnixSocket::readFrame(fd, request))
+        {
+            Metrics::Scope scope(Metrics::timer("compile_server.latency"));
+            if (!UnixSocket::writeFrame(fd, handler(std::move(request))))
+                break;
+        }
+
+        std::lock_guard<std::mutex> lock(conn_mutex);
+        connections.erase(fd);
+        close(fd);
+    }
+
+    void run()
+    {
+        while (running)
+        {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd == -1)
+                continue;
+            {
+                std::lock_guard<std::mutex> lock(conn_mutex);
+                connections.insert(fd);
+            }
+            Metrics::counter("compile_server.connect").add();
+            std::thread(&CompileServer::serve, this, fd).detach();
+        }
+    }
+
+public:
+    /**
+     * @param path 监听的套接字路径
+     * @param handler 处理一条请求并返回应答（在连接线程中调用）
+     */
+    CompileServer(const std::string &path, Handler handler) : path(path), listenFd(UnixSocket::listenOn(path, inode)),
+                                                              handler(std::move(handler))
+    {
+        acceptor = std::thread(&CompileServer::run, this);
+        std::cout << getCurrentTime() << "Compile API listening on " << path << std::endl;
+    }
+
+    /**
+     * @brief 停止接受新请求，等待进行中的请求应答完毕
+     */
+    ~CompileServer()
+    {
+        running = false;
+        shutdown(listenFd, SHUT_RDWR);
+        close(listenFd);
+        acceptor.join();
+        UnixSocket::release(path, inode);
+
+        {
+            std::lock_guard<std::mutex> lock(conn_mutex);
+            for (int fd : connections)
+                shutdown(fd, SHUT_RD); // 空闲连接立即返回，处理中的仍可写出应答
+        }
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(conn_mutex);
+                if (connections.empty())
+                    break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(MQ_ACK_INTERVAL));
+        }
+    }
+};
@@ -4,7 +4,88 @@
 #define MQ_PORT 5672
 #define MQ_USER "qingniao"
 #define MQ_PASSWORD "123456"
+#define MQ_CONSUME_TIMEOUT 1000 // 消费者单次阻塞等待时长（毫秒）
+#define MQ_ACK_INTERVAL 10      // 存在未确认任务时的等待时长（毫秒）
+
+#define WORKER_MIN_THREADS 10  // 线程池最小线程数
+#define WORKER_MAX_THREADS 100 // 线程池最大线程数
+#define MQ_PREFETCH_COUNT WORKER_MAX_THREADS // 预取窗口总量，与线程池容量一致，由各消费线程均分
+#define MQ_CONSUMER_THREADS 4                // 消费线程数，每个线程独占一个通道
+
+// 优先通道：各通道在竞争时保底占用预取窗口的权重（百分比），contest 始终优先消费
+// 空闲通道的窗口借给活跃通道，只有 practice 有流量时它独占整个窗口
+#define LANE_WEIGHT_CONTEST 60
+#define LANE_WEIGHT_PRACTICE 30
+#define LANE_WEIGHT_REJUDGE 10
+#define LANE_IDLE_TIMEOUT 5000 // 超过该时长（毫秒）未收到消息的通道视为空闲
+
+// 按语言分片：形如 "C++:16,Java:2"，每种语言独立队列 CompileQueueInput.lang.<语言>、
+// 独立消费者与并发上限；为空时使用上面的共享队列与共享线程池
+#define LANGUAGE_SHARDS ""
+
+// 题目亲和路由：非空时声明本节点队列 CompileQueueInput.node.<ID> 并绑定到一致性哈希交换机
+// （需启用 rabbitmq_consistent_hash_exchange 插件，上游以题目 ID 作为 routing key 投递）；
+// 节点队列已满时新任务、滞留超过 TTL 的任务转投共享队列 CompileQueueInput，由其他节点处理
+#define AFFINITY_NODE_ID ""
+#define AFFINITY_EXCHANGE "CompileExchange.affinity"
+#define AFFINITY_QUEUE_LENGTH 200  // 节点队列长度上限，视为饱和阈值
+#define AFFINITY_QUEUE_TTL 30000   // 任务在节点队列中的最长等待（毫秒），节点宕机时由此转投
+#define MQ_PUBLISHER_POOL_SIZE 8             // 推送通道池保留的空闲连接数
+#define MQ_PUBLISH_BATCH 64                  // 回送线程单批最多推送的结果数
+#define MQ_PUBLISH_WINDOW 8                  // 同时在途的推送确认数（每条占用一个推送通道），不超过推送通道池容量
+#define MQ_RECONNECT_MIN_MS 100              // 重连退避初始上限（毫秒）
+#define MQ_RECONNECT_MAX_MS 30000            // 重连退避最大间隔（毫秒）
+#define MQ_RECONNECT_ATTEMPTS 5              // 推送失败时的最大重连次数
+#define RESULT_COMPRESSION ""                // 结果压缩："gzip" 启用（content-encoding: gzip），为空不压缩
+#define RESULT_COMPRESS_MIN 4096             // 小于该字节数的结果不压缩
+#define RESULT_CHUNK_THRESHOLD 0             // 超过该字节数（压缩前）的结果分片发送（见 RabbitMQPush::sendChunked），为 0 不分片
+#define RESULT_CHUNK_SIZE (1024 * 1024)      // 分片大小（字节）
+
+#define METRICS_INTERVAL 60 // 指标输出间隔（秒）
+// 传输层："amqp" 使用 RabbitMQ；"memory" 使用进程内队列；
+// "unix" 在进程内队列之上于 UNIX_SOCKET_PATH 提供 broker 替身，供同主机进程收发消息
+#define TRANSPORT "amqp"
+#define TRANSPORT_INPUT ""                         // 非 amqp 时启动预载的任务文件，每行一条 JSON
+#define UNIX_SOCKET_PATH "/tmp/judge/broker.sock"
+#define UNIX_FRAME_LIMIT (256U * 1024 * 1024)      // 单帧上限（字节）
+#define MEMORY_QUEUE_LIMIT 10000                   // 进程内单个队列的消息数上限
+#define MEMORY_QUEUE_BYTES (256ULL * 1024 * 1024)  // 进程内单个队列的字节数上限
+#define UNIX_MAX_CONNECTIONS 64                    // broker 替身同时服务的连接数上限
+#define COMPILE_SOCKET_PATH "/tmp/judge/compile.sock" // 同步编译接口，为空时不启用
 #define FILE_ROOT_PATH "/tmp/judge/"
+#define SPOOL_FILE "results.spool"              // 结果暂存文件，位于 FILE_ROOT_PATH 下
+#define SPOOL_CAPACITY (256ULL * 1024 * 1024)     // 暂存容量（字节）
+#define SPOOL_REPLAY_INTERVAL 1000                // 暂存重放检查间隔（毫秒）
+#define SPOOL_SLOTS 4                             // 暂存槽位数，供新旧进程交接时各用一个
+#define TASK_INDEX_DIR "done"                     // 已完成任务的内容指纹，位于 FILE_ROOT_PATH 下
+#define TASK_INDEX_MEMORY 4096                    // 内存中保留的最近完成记录数
+#define TASK_INDEX_TTL 3600                       // 磁盘记录保留时长（秒）
+#define ASSET_CACHE_DIR "assets"                  // 题目附加文件缓存，位于 FILE_ROOT_PATH 下
+#define ASSET_CACHE_TTL 604800                    // 附加文件未被使用的保留时长（秒）
+#define COMPILE_CACHE_DIR "compile_cache"         // 编译缓存，位于 FILE_ROOT_PATH 下
+#define COMPILE_CACHE_BYTES (1024 * 1024 * 1024)  // 编译缓存容量（字节），为 0 时不启用
+#define ARTIFACT_STORE_ROOT ""                    // 产物存储根目录（与评测机共享），非空时结果只携带产物引用
+#define ARTIFACT_STORE_TTL 86400                  // 产物保留时长（秒）
+#define ARTIFACT_SHM 0                            // 非 0 时产物写入共享内存段，结果只携带段名（评测机须同主机）
+#define ARTIFACT_SHM_SLOTS 256                    // 未确认的段数上限，达到后产物改走产物存储或内联
+#define ARTIFACT_SHM_BYTES (48ULL * 1024 * 1024)  // 未确认的总字节数上限，另受 /dev/shm 容量的 3/4 限制（Docker 默认 64 MB）
+#define ARTIFACT_SHM_TTL 600                      // 未被评测机确认（shm_unlink）的段在结果发出后的保留时长（秒）
+
+// 平滑退出：收到 SIGTERM / SIGINT 后停止消费，等待进行中的任务完成并回送结果
+#define DRAIN_TIMEOUT 60                  // 等待进行中任务的最长时间（秒）
+#define PID_FILE "judge-compile.pid"      // 位于 FILE_ROOT_PATH 下
+#define HANDOFF 0                         // 非 0 时启动并开始消费后，向 PID_FILE 中的旧进程发送 SIGTERM
+
+// 取消通道：控制消息经 fanout 交换机广播到每个节点，形如 {"cancel": ["taskID", ...]}
+#define CONTROL_EXCHANGE "CompileExchange.control"
+#define CANCEL_TTL 600 // 取消记录保留时长（秒）
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "nlohmann/json.hpp"
 
@@ -21,7 +102,9 @@ enum class TaskStatus
     CE = -4,
     TLE = -5,
     MLE = -6,
-    OLE = -7
+    OLE = -7,
+    CANCELLED = -8,
+    MISSING_ASSETS = -9
 };
 
 // 自定义编译异常
@@ -38,6 +121,54 @@ public:
     }
 };
 
+// 任务已取消
+class task_cancelled : public std::exception
+{
+public:
+    const char *what() const noexcept override
+    {
+        return "cancelled";
+    }
+};
+
+// 引用的附加文件不在本地缓存中
+class assets_missing : public std::exception
+{
+public:
+    std::vector<std::string> hashes;
+
+    assets_missing(std::vector<std::string> hashes) : hashes(std::move(hashes)) {}
+    const char *what() const noexcept override
+    {
+        return "assets missing";
+    }
+};
+
+// 读取整型配置：同名环境变量优先，否则使用编译期默认值
+int getSetting(const char *name, int defaultValue)
+{
+    const char *value = std::getenv(name);
+    if (value == nullptr || *value == '\0')
+        return defaultValue;
+    try
+    {
+        return std::stoi(value);
+    }
+    catch (const std::exception &)
+    {
+        return defaultValue;
+    }
+}
+
+// 读取字符串配置：同名环境变量优先，否则使用编译期默认值
+std::string getSetting(const char *name, const char *defaultValue)
+{
+    const char *value = std::getenv(name);
+    if (value == nullptr || *value == '\0')
+        return defaultValue;
+    return value;
+}
+
 // 生成当前时间的格式化字符串
 std::string getCurrentTime()
 {
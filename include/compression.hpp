@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <zlib.h>
+
+#include "compile_settings.h"
+
+// 结果压缩：gzip 格式，经 AMQP content-encoding 声明
+// 压缩级别按负载大小与当前 CPU 余量自适应：小负载压得更狠，大负载或 CPU 紧张时降级，避免拖慢回送线程
+
+class Compression
+{
+public:
+    /**
+     * @brief 按负载大小与 CPU 余量选择压缩级别
+     * @param size 负载字节数
+     * @return zlib 压缩级别（1 ~ 9）
+     */
+    static int adaptiveLevel(size_t size)
+    {
+        int level = size < 64 * 1024 ? 9 : size < 1024 * 1024 ? 6 : 4;
+
+        // CPU 余量：1 分钟平均负载相对核数
+        double load;
+        unsigned int cores = std::max(1U, std::thread::hardware_concurrency());
+        if (getloadavg(&load, 1) == 1)
+        {
+            double headroom = 1.0 - load / cores;
+            if (headroom < 0.1)
+                level = 1;
+            else if (headroom < 0.3)
+                level = std::min(level, 3);
+        }
+        return level;
+    }
+
+    /**
+     * @brief gzip 压缩
+     * @param input 原始数据
+     * @param level 压缩级别
+     */
+    static std::string gzip(const std::string &input, int level)
+    {
+        z_stream stream{};
+        // windowBits 15 + 16：输出 gzip 头尾
+        if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("deflateInit failed");
+
+        std::string output;
+        output.resize(deflateBound(&stream, input.size()));
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+        stream.avail_in = input.size();
+        stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+        stream.avail_out = output.size();
+        int ret = deflate(&stream, Z_FINISH);
+        output.resize(stream.total_out);
+        deflateEnd(&stream);
+        if (ret != Z_STREAM_END)
+            throw std::runtime_error("deflate failed");
+        return output;
+    }
+
+    /**
+     * @brief 流式 gzip 压缩：输出按 chunkSize 分段交给 emit，内存中只保留一个分段
+     * @param input 原始数据
+     * @param level 压缩级别
+     * @param chunkSize 分段大小，除最后一段外均为该大小
+     * @param emit 处理一个分段，调用期间分段内容有效
+     */
+    static void gzipChunks(const std::string &input, int level, size_t chunkSize,
+                           const std::function<void(const std::string &)> &emit)
+    {
+        z_stream stream{};
+        if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("deflateInit failed");
+
+        std::string chunk(chunkSize, '\0');
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+        stream.avail_in = input.size();
+        int ret;
+        try
+        {
+            do
+            { // Z_FINISH 下输出区写满时返回 Z_OK，全部输出后返回 Z_STREAM_END
+                stream.next_out = reinterpret_cast<Bytef *>(&chunk[0]);
+                stream.avail_out = chunk.size();
+                ret = deflate(&stream, Z_FINISH);
+                if (ret != Z_OK && ret != Z_STREAM_END)
+                    break;
+                size_t produced = chunk.size() - stream.avail_out;
+                if (produced < chunk.size()) // 最后一段
+                    chunk.resize(produced);
+                if (produced > 0)
+                    emit(chunk);
+            } while (ret != Z_STREAM_END);
+        }
+        catch (...)
+        {
+            deflateEnd(&stream);
+            throw;
+        }
+        deflateEnd(&stream);
+        if (ret != Z_STREAM_END)
+            throw std::runtime_error("deflate failed");
+    }
+
+    /**
+     * @brief gzip 解压，供输入消息解码与消费端校验使用
+     * @param input gzip 数据
+     * @param limit 解压后大小上限（字节）
+     */
+    static std::string gunzip(const std::string &input, size_t limit = UNIX_FRAME_LIMIT)
+    {
+        z_stream stream{};
+        if (inflateInit2(&stream, 15 + 16) != Z_OK)
+            throw std::runtime_error("inflateInit failed");
+
+        std::string output;
+        char buffer[64 * 1024];
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+        stream.avail_in = input.size();
+        int ret;
+        do
+        {
+            stream.next_out = reinterpret_cast<Bytef *>(buffer);
+            stream.avail_out = sizeof(buffer);
+            ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END)
+                break;
+            output.append(buffer, sizeof(buffer) - stream.avail_out);
+        } while (ret != Z_STREAM_END && output.size() <= limit);
+        inflateEnd(&stream);
+        if (ret != Z_STREAM_END)
+            throw std::runtime_error("inflate failed");
+        return output;
+    }
+};
@@ -4,6 +4,7 @@
 #include <boost/filesystem.hpp>
 #include <sys/wait.h>
 
+#include "compile_cache.hpp"
 #include "compile_interface.h"
 #include "compile_settings.h"
 
@@ -54,16 +55,14 @@ public:
         answerFile << answer["code"].get<std::string>();
     }
 
-    void compile() override
+    /**
+     * @brief g++ 参数
+     */
+    std::vector<std::string> compileArgs()
     {
         json extra = taskData["extra"];
 
-        // 构造 g++ 参数数组
-        std::vector<const char *> args;
-        args.push_back("g++");
-        args.push_back("-o");
-        args.push_back("main");
-        args.push_back("main.cpp");
+        std::vector<std::string> args = {"g++", "-o", "main", "main.cpp"};
         for (auto &item : extra.items())
         {
             std::string key = item.key();
@@ -71,9 +70,24 @@ public:
             std::string suffix = key.substr(key.find_last_of('.') + 1);
             if (suffix == "cpp" || suffix == "hpp")
             { // 附加编译参数
-                args.push_back(key.c_str());
+                args.push_back(key);
             }
         }
+        return args;
+    }
+
+    std::string signature() override
+    {
+        return CompileCache::signature(compileArgs(), CompileCache::toolchainVersion("g++"));
+    }
+
+    void compile() override
+    {
+        // 构造 g++ 参数数组
+        std::vector<std::string> argList = compileArgs();
+        std::vector<const char *> args;
+        for (auto &arg : argList)
+            args.push_back(arg.c_str());
         args.push_back(nullptr); // execvp 要求以 nullptr 结尾
 
         // 创建管道用于获取编译失败信息
@@ -93,6 +107,7 @@ public:
         }
         else if (pid == 0)
         {                     // 子进程
+            setpgid(0, 0);    // 自立进程组，取消时连同编译器派生的进程一并终止
             close(pipefd[0]); // 关闭读端
             dup2(pipefd[1], STDERR_FILENO);
             close(pipefd[1]);
@@ -113,9 +128,10 @@ public:
         else if (pid > 0)
         {                     // 父进程
             close(pipefd[1]); // 关闭写端
+            trackChild(pid);  // 登记子进程，取消时由 cancel() 终止
 
             int status;
-            waitpid(pid, &status, 0); // 等待子进程结束
+            waitChild(pid, status); // 等待子进程结束
 
             // 读取错误信息
             char buffer[1024];
@@ -126,6 +142,7 @@ public:
             }
             close(pipefd[0]);
 
+            checkCancelled();
             if (status != 0)
             { // 子进程本身出错
                 throw std::runtime_error("Compile failed");
@@ -151,11 +168,7 @@ public:
         {
             throw std::runtime_error("File not exists");
         }
-        std::string base64str;
-        Base64::EncodeFileToBase64(mainPath, base64str);
-        // 放入TaskData.task.result
-        json result;
-        result["main"] = base64str;
-        taskData["task"]["result"].push_back(result);
+        // 放入TaskData.task.result，哈希与大小记入TaskData.task.resultMeta
+        addResult(taskData, "main", mainPath);
     }
 };
\ No newline at end of file
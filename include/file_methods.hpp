@@ -13,6 +13,41 @@ using namespace std;
 using namespace boost::archive::iterators;
 namespace fs = boost::filesystem;
 
+class BinaryFile {
+public:
+    /**
+     * @brief 读取文件的原始字节，按文件大小一次分配
+     * @param filePath 文件路径
+     * @param output 文件内容（string 或 vector<uint8_t>）
+     */
+    template <typename Container>
+    static void ReadFile(const fs::path &filePath, Container &output) {
+        ifstream file(filePath, ios::binary | ios::ate);
+        if (!file) {
+            throw runtime_error("Cannot open file for reading");
+        }
+
+        output.resize(file.tellg());
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(output.data()), output.size());
+    }
+
+    /**
+     * @brief 写入原始字节
+     * @param data 数据
+     * @param size 字节数
+     * @param outputFilePath 输出文件路径
+     */
+    static void WriteFile(const char *data, size_t size, const fs::path &outputFilePath) {
+        ofstream file(outputFilePath, ios::binary);
+        if (!file) {
+            throw runtime_error("Cannot open file for writing");
+        }
+
+        file.write(data, size);
+    }
+};
+
 class Base64 {
 public:
     Base64() {}
@@ -24,21 +59,35 @@ public:
      * @param output 输出的 Base64 字符串
      */
 	static void EncodeFileToBase64(const fs::path &filePath, string &output) {
-        ifstream file(filePath, ios::binary);
-        if (!file) {
-            throw runtime_error("Cannot open file for reading");
+        string input;
+        BinaryFile::ReadFile(filePath, input);
+        if (!Base64Encode(input, &output)) {
+            throw runtime_error("Base64 encoding failed");
         }
+    }
 
-        stringstream buffer;
-        buffer << file.rdbuf();
-        file.close();
-
-        string input = buffer.str();
+    /**
+     * @brief 将内存中的数据编码为 Base64 字符串
+     * @param input 原始数据
+     * @param output 输出的 Base64 字符串
+     */
+    static void EncodeToBase64(const string &input, string &output) {
         if (!Base64Encode(input, &output)) {
             throw runtime_error("Base64 encoding failed");
         }
     }
 
+    /**
+     * @brief 将 Base64 字符串解码到内存
+     * @param base64str Base64 字符串
+     * @param output 解码后的数据
+     */
+    static void DecodeFromBase64(const string &base64str, string &output) {
+        if (!Base64Decode(base64str, &output)) {
+            throw runtime_error("Base64 decoding failed");
+        }
+    }
+
     /**
      * @brief 将 Base64 字符串解码并写入文件
      * @param base64str Base64 字符串
@@ -64,18 +113,16 @@ private:
     static bool Base64Encode( const string &input, string *output)
     {
     	typedef base64_from_binary<transform_width<string::const_iterator, 6, 8>> Base64EncodeIterator;
-    	stringstream result;
+    	// 按编码后长度一次分配，直接写入输出
+    	output->clear();
+    	output->reserve( ( input.length() + 2 ) / 3 * 4 );
     	try {
-    		copy( Base64EncodeIterator( input.begin() ), Base64EncodeIterator( input.end() ), ostream_iterator<char>( result ) );
+    		copy( Base64EncodeIterator( input.begin() ), Base64EncodeIterator( input.end() ), back_inserter( *output ) );
     	} catch ( ... ) {
     		return false;
     	}
     	size_t equal_count = (3 - input.length() % 3) % 3;
-    	for ( size_t i = 0; i < equal_count; i++ )
-    	{
-    		result.put( '=' );
-    	}
-    	*output = result.str();
+    	output->append( equal_count, '=' );
     	return output->empty() == false;
     }
  
@@ -89,6 +136,9 @@ private:
     		return false;
     	}
     	*output = result.str();
+    	// 末尾的 '=' 按 0 解码，去掉多出的字节
+    	size_t padding = input.size() - input.find_last_not_of('=') - 1;
+    	output->resize(output->size() - min(padding, output->size()));
     	return output->empty() == false;
     }
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <boost/filesystem.hpp>
 #include <sys/wait.h>
 
+#include "compile_cache.hpp"
 #include "compile_interface.h"
 #include "compile_settings.h"
 #include "file_methods.hpp"
@@ -55,13 +56,27 @@ public:
         answerFile << answer["code"].get<std::string>();
     }
 
+    /**
+     * @brief javac 参数
+     */
+    std::vector<std::string> compileArgs()
+    {
+        return {"javac", "*.java"}; // 编译所有java文件
+    }
+
+    std::string signature() override
+    {
+        return CompileCache::signature(compileArgs(), CompileCache::toolchainVersion("javac", "-version"));
+    }
+
     void compile() override
     {
         // javac
+        std::vector<std::string> argList = compileArgs();
         std::vector<const char *> args;
-        args.push_back("javac");
-        args.push_back("*.java"); // 编译所有java文件
-        args.push_back(nullptr);
+        for (auto &arg : argList)
+            args.push_back(arg.c_str());
+        args.push_back(nullptr); // execvp 要求以 nullptr 结尾
 
         // pipe
         int pipefd[2];
@@ -80,6 +95,7 @@ public:
         }
         else if (pid == 0)
         {                     // 子进程
+            setpgid(0, 0);    // 自立进程组，取消时连同编译器派生的进程一并终止
             close(pipefd[0]); // 关闭读端
             dup2(pipefd[1], STDERR_FILENO);
             close(pipefd[1]);
@@ -100,9 +116,10 @@ public:
         else if (pid > 0)
         {                     // 父进程
             close(pipefd[1]); // 关闭写端
+            trackChild(pid);  // 登记子进程，取消时由 cancel() 终止
 
             int status;
-            waitpid(pid, &status, 0); // 等待子进程结束
+            waitChild(pid, status); // 等待子进程结束
 
             // 读取错误信息
             char buffer[1024];
@@ -113,6 +130,7 @@ public:
             }
             close(pipefd[0]);
 
+            checkCancelled();
             if (status != 0)
             { // 子进程本身出错
                 throw std::runtime_error("Compile failed");
@@ -138,13 +156,8 @@ public:
 
                 if (extension == ".class")
                 {
-                    json resultItem;
-                    std::string base64Str;
-                    Base64::EncodeFileToBase64(filePath, base64Str);
-
-                    // 放入TaskData.task.result
-                    resultItem[fileName] = base64Str;
-                    taskData["task"]["result"].push_back(resultItem);
+                    // 放入TaskData.task.result，哈希与大小记入TaskData.task.resultMeta
+                    addResult(taskData, fileName, filePath);
                 }
             }
         }
@@ -40,6 +40,10 @@ public:
         json answer = task["answer"];
         json extra = taskData["extra"];
 
+        // 模块文件：哈希引用从附加文件缓存取出，内联的记下哈希供 transcode() 转回时使用
+        if (!extra.is_null())
+            saveFromJsonList(extra, taskDir);
+
         // answer
         std::ofstream answerFile(fs::path(taskDir / "main.lua"));
         if (!answerFile)
@@ -62,14 +66,9 @@ public:
         {
             throw std::runtime_error("File not exists");
         }
-        std::string base64str;
-        Base64::EncodeFileToBase64(mainPath, base64str);
-        // 放入TaskData.task.result
-        json result;
-        result["main.lua"] = base64str;
-        taskData["task"]["result"].push_back(result);
+        // 放入TaskData.task.result，哈希与大小记入TaskData.task.resultMeta
+        addResult(taskData, "main.lua", mainPath);
         // 转移extra中模块文件
-        taskData["task"]["result"].insert(taskData["task"]["result"].end(),
-                                          taskData["extra"].begin(), taskData["extra"].end());
+        forwardExtra(taskData, taskDir);
     }
 };
\ No newline at end of file
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "transport.hpp"
+#include "metrics.hpp"
+
+// 进程内传输：以命名队列模拟 broker，用于脱离 RabbitMQ 单独压测编译流水线，
+// 也是 Unix 域套接字传输（unix_transport.hpp）的存储层
+
+class MemoryBroker
+{
+public:
+    // 队列已满时的处理方式
+    enum class Overflow
+    {
+        REJECT,      // 拒收新消息，由投递方重试（任务）
+        DROP_OLDEST, // 丢弃最早的消息（结果）
+        UNBOUNDED,   // 不限（启动预载、重新入队）
+    };
+
+private:
+    struct Queue
+    {
+        std::deque<std::string> messages;
+        size_t bytes = 0;
+    };
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::map<std::string, Queue> queues;
+
+    static bool full(const Queue &queue, size_t incoming)
+    {
+        return queue.messages.size() >= MEMORY_QUEUE_LIMIT || queue.bytes + incoming > MEMORY_QUEUE_BYTES;
+    }
+
+public:
+    MemoryBroker() {};
+
+    ~MemoryBroker() {};
+
+    static MemoryBroker &instance()
+    {
+        static MemoryBroker broker;
+        return broker;
+    }
+
+    /**
+     * @brief 投递消息；队列的消息数上限为 MEMORY_QUEUE_LIMIT，字节数上限为 MEMORY_QUEUE_BYTES
+     * @param overflow 队列已满时的处理方式
+     * @return 被拒收时返回 false
+     */
+    bool publish(const std::string &queue, std::string body, Overflow overflow)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto &target = queues[queue];
+            if (overflow == Overflow::REJECT && full(target, body.size()))
+            {
+                Metrics::counter("transport.memory.rejected").add();
+                return false;
+            }
+            while (overflow == Overflow::DROP_OLDEST && !target.messages.empty() && full(target, body.size()))
+            {
+                target.bytes -= target.messages.front().size();
+                target.messages.pop_front();
+                Metrics::counter("transport.memory.dropped").add();
+            }
+            target.bytes += body.size();
+            target.messages.push_back(std::move(body));
+        }
+        ready.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief 未确认的消息放回队首，不受容量限制（已被接收过）
+     */
+    void requeue(const std::string &queue, std::string body)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto &target = queues[queue];
+            target.bytes += body.size();
+            target.messages.push_front(std::move(body));
+        }
+        ready.notify_all();
+    }
+
+    /**
+     * @brief 按顺序检查各队列，取出第一条消息；都为空时阻塞等待
+     * @param names 队列名，靠前的优先
+     * @param body 取出的消息
+     * @param index 消息所在队列在 names 中的下标
+     * @param timeout 等待超时（毫秒）
+     * @return 超时返回 false
+     */
+    bool consume(const std::vector<std::string> &names, std::string &body, size_t &index, int timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto take = [&]
+        {
+            for (index = 0; index < names.size(); index++)
+            {
+                auto &queue = queues[names[index]];
+                if (!queue.messages.empty())
+                {
+                    body = std::move(queue.messages.front());
+                    queue.messages.pop_front();
+                    queue.bytes -= body.size();
+                    return true;
+                }
+            }
+            return false;
+        };
+        return ready.wait_for(lock, std::chrono::milliseconds(timeout), take);
+    }
+};
+
+class MemoryTaskSource : public TaskSource
+{
+private:
+    std::vector<std::string> queues; // 按优先级排列
+    std::vector<std::string> lanes;
+
+    // 未确认的消息，失败时重新投递
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::pair<size_t, std::string>> unacked;
+    uint64_t nextTag = 0;
+
+public:
+    /**
+     * @param subscriptions (队列名, 所属通道) 列表，靠前的优先消费
+     */
+    MemoryTaskSource(const std::vector<std::pair<std::string, std::string>> &subscriptions)
+    {
+        for (auto &[queue, lane] : subscriptions)
+        {
+            queues.push_back(queue);
+            lanes.push_back(lane);
+        }
+    }
+
+    ~MemoryTaskSource() override {};
+
+    bool pullTaskData(TaskMessage &message, int timeout = MQ_CONSUME_TIMEOUT) override
+    {
+        size_t index;
+        if (!MemoryBroker::instance().consume(queues, message.body, index, timeout))
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        message.delivery.tag = ++nextTag;
+        message.lane = lanes[index];
+        message.timestamp = 0;
+        message.reply = ReplyAddress();
+        message.contentType.clear();
+        message.contentEncoding.clear();
+        message.received = std::chrono::steady_clock::now();
+        unacked[message.delivery.tag] = {index, message.body};
+        return true;
+    }
+
+    void ack(const Delivery &delivery, bool success = true) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = unacked.find(delivery.tag);
+        if (it == unacked.end())
+            return;
+        if (!success) // 重新入队
+            MemoryBroker::instance().requeue(queues[it->second.first], std::move(it->second.second));
+        unacked.erase(it);
+    }
+
+    bool drain(std::chrono::steady_clock::time_point deadline) override
+    {
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (unacked.empty())
+                    return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(MQ_ACK_INTERVAL));
+        }
+        return false;
+    }
+};
+
+class MemoryResultSink : public ResultSink
+{
+private:
+    std::string queue;
+
+public:
+    MemoryResultSink(const std::string &queue) : queue(queue) {}
+
+    ~MemoryResultSink() override {};
+
+    // 进程内队列只传递消息体，不携带 content-type；无人取走的结果超出容量时丢弃最早的
+    void pushMessage(const std::string &body, const std::string &) override
+    {
+        MemoryBroker::instance().publish(queue, body, MemoryBroker::Overflow::DROP_OLDEST);
+        Metrics::counter("transport.memory.output").add();
+    }
+
+    void pushReply(const ReplyAddress &reply, const std::string &body, const std::string &) override
+    {
+        MemoryBroker::instance().publish(reply.queue, body, MemoryBroker::Overflow::DROP_OLDEST);
+        Metrics::counter("transport.memory.reply").add();
+    }
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+
+#include "compile_settings.h"
+
+// 消息封装：按 content-type 在 JSON 与二进制格式（CBOR / MessagePack）之间编解码
+// 二进制格式中文件以原始字节（json::binary）传输，不经 base64；未设置 content-type 的旧客户端仍使用 JSON
+
+class MessageCodec
+{
+public:
+    enum class Format
+    {
+        JSON,
+        CBOR,
+        MSGPACK
+    };
+
+    /**
+     * @brief 由 content-type 确定格式，未知或为空时按 JSON 处理
+     */
+    static Format format(const std::string &contentType)
+    {
+        if (contentType == "application/cbor")
+            return Format::CBOR;
+        if (contentType == "application/msgpack" || contentType == "application/x-msgpack")
+            return Format::MSGPACK;
+        return Format::JSON;
+    }
+
+    /**
+     * @brief 解析消息体，格式错误时抛出 json::exception
+     */
+    static json decode(const std::string &body, const std::string &contentType)
+    {
+        switch (format(contentType))
+        {
+        case Format::CBOR:
+            return json::from_cbor(body);
+        case Format::MSGPACK:
+            return json::from_msgpack(body);
+        default:
+            return json::parse(body);
+        }
+    }
+
+    /**
+     * @brief 按 content-type 序列化，二进制格式直接写入返回的字符串
+     */
+    static std::string encode(const json &data, const std::string &contentType)
+    {
+        std::string body;
+        switch (format(contentType))
+        {
+        case Format::CBOR:
+            json::to_cbor(data, body);
+            break;
+        case Format::MSGPACK:
+            json::to_msgpack(data, body);
+            break;
+        default:
+            body = data.dump();
+        }
+        return body;
+    }
+
+    /**
+     * @brief 打包为带格式的存储记录（暂存）；JSON 原样保存，兼容旧记录
+     */
+    static std::string pack(const std::string &contentType, std::string body)
+    {
+        if (format(contentType) == Format::JSON)
+            return body;
+        std::string record;
+        record.reserve(contentType.size() + body.size() + 2);
+        record += '\0';
+        record += contentType;
+        record += '\n';
+        record += body;
+        return record;
+    }
+
+    /**
+     * @brief 拆解 pack() 生成的存储记录
+     */
+    static void unpack(const std::string &record, std::string &contentType, std::string &body)
+    {
+        size_t pos;
+        if (record.empty() || record[0] != '\0' || (pos = record.find('\n')) == std::string::npos)
+        {
+            contentType.clear();
+            body = record;
+            return;
+        }
+        contentType = record.substr(1, pos - 1);
+        body = record.substr(pos + 1);
+    }
+};
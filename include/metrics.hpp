@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "compile_settings.h"
+
+// 进程内指标：计数器、数值分布与耗时统计，由主线程定期输出到日志
+
+class Metrics
+{
+public:
+    class Counter
+    {
+    private:
+        std::atomic<uint64_t> value{0};
+
+    public:
+        void add(uint64_t n = 1) { value += n; }
+        uint64_t get() const { return value; }
+    };
+
+    class Summary
+    {
+    private:
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> max{0};
+
+    public:
+        /**
+         * @brief 记录一次取值
+         */
+        void record(uint64_t value)
+        {
+            count++;
+            total += value;
+            uint64_t prev = max;
+            while (value > prev && !max.compare_exchange_weak(prev, value))
+                ;
+        }
+
+        uint64_t getCount() const { return count; }
+        uint64_t getAvg() const { return count ? total / count : 0; }
+        uint64_t getMax() const { return max; }
+    };
+
+    // 耗时统计，单位微秒
+    class Timer : public Summary
+    {
+    };
+
+    /**
+     * @brief RAII 计时，析构时写入对应 Timer
+     */
+    class Scope
+    {
+    private:
+        Timer &timer;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        Scope(Timer &timer) : timer(timer), start(std::chrono::steady_clock::now()) {}
+        ~Scope() { timer.record(elapsedUs(start)); }
+    };
+
+    static Counter &counter(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        auto &ptr = registry().counters[name];
+        if (!ptr)
+            ptr.reset(new Counter);
+        return *ptr;
+    }
+
+    static Summary &summary(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        auto &ptr = registry().summaries[name];
+        if (!ptr)
+            ptr.reset(new Summary);
+        return *ptr;
+    }
+
+    static Timer &timer(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        auto &ptr = registry().timers[name];
+        if (!ptr)
+            ptr.reset(new Timer);
+        return *ptr;
+    }
+
+    /**
+     * @brief 距 start 经过的微秒数
+     */
+    static uint64_t elapsedUs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    }
+
+    /**
+     * @brief 输出全部指标
+     */
+    static void report(std::ostream &os)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        for (auto &[name, c] : registry().counters)
+            os << getCurrentTime() << "[metric] " << name << " = " << c->get() << std::endl;
+        for (auto &[name, v] : registry().summaries)
+            os << getCurrentTime() << "[metric] " << name << " count=" << v->getCount()
+               << " avg=" << v->getAvg() << " max=" << v->getMax() << std::endl;
+        for (auto &[name, t] : registry().timers)
+            os << getCurrentTime() << "[metric] " << name << " count=" << t->getCount()
+               << " avg=" << t->getAvg() << "us max=" << t->getMax() << "us" << std::endl;
+    }
+
+private:
+    struct Registry
+    {
+        std::mutex mutex;
+        std::map<std::string, std::unique_ptr<Counter>> counters;
+        std::map<std::string, std::unique_ptr<Summary>> summaries;
+        std::map<std::string, std::unique_ptr<Timer>> timers;
+    };
+
+    static Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+};
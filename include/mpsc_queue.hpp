@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/**
+ * @brief 无锁多生产者单消费者队列（Vyukov 链表队列）
+ * push 可由任意线程并发调用；pop / empty 只能由唯一的消费线程调用
+ */
+template <typename T>
+class MPSCQueue
+{
+private:
+    struct Node
+    {
+        std::atomic<Node *> next{nullptr};
+        T value;
+    };
+
+    std::atomic<Node *> head; // 生产者端
+    Node *tail;               // 消费者端（哨兵）
+
+public:
+    MPSCQueue() : head(new Node), tail(head.load()) {}
+
+    ~MPSCQueue()
+    {
+        T value;
+        while (pop(value))
+            ;
+        delete tail;
+    }
+
+    MPSCQueue(const MPSCQueue &) = delete;
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    void push(T &&value)
+    {
+        Node *node = new Node;
+        node->value = std::move(value);
+        Node *prev = head.exchange(node);
+        prev->next.store(node);
+    }
+
+    /**
+     * @brief 取出队首元素
+     * @return 队列为空（或生产者尚未完成链接）时返回 false
+     */
+    bool pop(T &value)
+    {
+        Node *next = tail->next.load();
+        if (next == nullptr)
+            return false;
+        value = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+    bool empty() const
+    {
+        return tail->next.load() == nullptr;
+    }
+};
@@ -1,59 +1,328 @@
 #pragma once
 
 #include <SimpleAmqpClient/SimpleAmqpClient.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
 
 #include "compile_settings.h"
+#include "compression.hpp"
+#include "metrics.hpp"
+#include "transport.hpp"
 
 using namespace AmqpClient;
 
-// 推送由主线程完成；拉取由工作线程完成，每个线程一个通道
+// 拉取由若干消费线程完成，每个线程一个通道；推送由工作线程完成，推送通道由 RabbitMQPushPool 长期复用
+// 消息采用手动确认：结果回送成功后才 ack，进程崩溃时未确认任务由 broker 重新投递
 
-class RabbitMQPull {
+/**
+ * @brief 输入队列订阅：队列名、所属通道（lane）与预取窗口
+ * 通道由订阅的队列决定，不读取任务内容；现有生产者均投递到 CompileQueueInput（practice）
+ */
+struct QueueSubscription {
+    std::string queue;
+    std::string lane;
+    uint16_t prefetch;
+    Table arguments = {};           // 声明队列的附加参数
+    std::string exchange = {};      // 非空时声明该交换机并绑定队列
+    std::string exchange_type = {};
+    std::string binding_key = {};
+};
+
+/**
+ * @brief 带随机抖动的指数退避
+ */
+class Backoff {
+private:
+    int attempt = 0;
+    std::mt19937 rng{std::random_device{}()};
+
+public:
+    /**
+     * @brief 等待下一次重试：在 [上限/2, 上限] 内随机，上限从 MQ_RECONNECT_MIN_MS 起逐次翻倍
+     * @param stop 非空时分段等待，置位后立即返回
+     */
+    void wait(const std::atomic<bool> *stop = nullptr) {
+        int ceiling = MQ_RECONNECT_MIN_MS << std::min(attempt++, 16);
+        ceiling = std::min(ceiling, MQ_RECONNECT_MAX_MS);
+        std::uniform_int_distribution<int> dist(ceiling / 2, ceiling);
+        auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(dist(rng));
+        while (std::chrono::steady_clock::now() < until && !(stop && *stop))
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+                until - std::chrono::steady_clock::now(), std::chrono::milliseconds(MQ_ACK_INTERVAL)));
+    }
+
+    int attempts() const { return attempt; }
+};
+
+class RabbitMQPull : public TaskSource {
 private:
-    std::string queue_input = "CompileQueueInput";
+    std::vector<QueueSubscription> subscriptions;
+    const std::atomic<bool> &stopping; // 进程开始退出，不再重连
     Channel::ptr_t channel_input;
+    bool connected = false;
+    std::vector<std::string> consume_tags;      // 按优先级排列
+    std::map<std::string, std::string> tag_lane; // consume_tag -> lane
+    std::map<std::string, size_t> tag_index;     // consume_tag -> 订阅序号
+
+    // 预取窗口借用：空闲通道只保留 1 个槽位，其余借给活跃通道；通道恢复活跃时立即收回
+    std::vector<uint16_t> lane_prefetch;                            // 各订阅当前生效的预取窗口
+    std::vector<std::chrono::steady_clock::time_point> lane_active; // 各订阅最近收到消息的时间
+    std::chrono::steady_clock::time_point rebalanced;
+    std::atomic<uint64_t> generation{0};         // 连接代数，每次重建加一
+
+    // 工作线程回报的确认结果，由拉取线程统一发送（通道非线程安全）
+    std::mutex ack_mutex;
+    std::vector<std::pair<Delivery, bool>> pending_acks;
+    std::atomic<int> unacked{0};
+
+    /**
+     * @brief 发送工作线程回报的 ack / reject
+     */
+    void flushAcks() {
+        std::vector<std::pair<Delivery, bool>> acks;
+        {
+            std::lock_guard<std::mutex> lock(ack_mutex);
+            acks.swap(pending_acks);
+        }
+        // 整批先行计数：发送中途抛出时其余消息随旧连接失效，由 broker 重新投递，不再等待其确认
+        unacked -= acks.size();
+        for (auto &[delivery, success] : acks) {
+            if (delivery.generation != generation) // 旧连接上的消息已由 broker 重新投递
+                continue;
+            Envelope::DeliveryInfo info;
+            info.delivery_tag = delivery.tag;
+            info.delivery_channel = delivery.channel;
+            if (success)
+                channel_input->BasicAck(info);
+            else // 回送失败，重新入队交由其他消费者处理
+                channel_input->BasicReject(info, true);
+        }
+    }
+
+    /**
+     * @brief 建立连接，声明队列并注册常驻消费者
+     */
+    void connect() {
+        connected = false;
+        channel_input = Channel::Create(MQ_HOST, MQ_PORT, MQ_USER, MQ_PASSWORD);
+        consume_tags.clear();
+        tag_lane.clear();
+        tag_index.clear();
+        lane_prefetch.clear();
+        lane_active.assign(subscriptions.size(), std::chrono::steady_clock::time_point());
+        for (auto &sub : subscriptions) {
+            channel_input->DeclareQueue(sub.queue, false, true, false, false, sub.arguments);
+            if (!sub.exchange.empty()) {
+                channel_input->DeclareExchange(sub.exchange, sub.exchange_type, false, true, false);
+                channel_input->BindQueue(sub.queue, sub.exchange, sub.binding_key);
+            }
+            std::string tag = channel_input->BasicConsume(
+                sub.queue, "", true,
+                false,/* no_ack */
+                false,/* exclusive */
+                sub.prefetch
+            );
+            tag_index[tag] = consume_tags.size();
+            consume_tags.push_back(tag);
+            tag_lane[tag] = sub.lane;
+            lane_prefetch.push_back(sub.prefetch);
+        }
+        rebalanced = std::chrono::steady_clock::now();
+        generation++;
+        connected = true;
+    }
+
+    bool laneActive(size_t i, std::chrono::steady_clock::time_point now) const {
+        return now - lane_active[i] < std::chrono::milliseconds(LANE_IDLE_TIMEOUT);
+    }
+
+    /**
+     * @brief 按通道活跃情况重新分配预取窗口
+     * 订阅的 prefetch 为竞争时的保底份额；空闲通道降为 1，活跃通道按份额比例分得全部窗口；
+     * 全部空闲时恢复初始份额
+     */
+    void rebalance() {
+        auto now = std::chrono::steady_clock::now();
+        rebalanced = now;
+        uint32_t budget = 0, activeShare = 0;
+        for (size_t i = 0; i < subscriptions.size(); i++) {
+            budget += subscriptions[i].prefetch;
+            if (laneActive(i, now))
+                activeShare += subscriptions[i].prefetch;
+        }
+        for (size_t i = 0; i < subscriptions.size(); i++) {
+            uint16_t target = subscriptions[i].prefetch;
+            if (activeShare > 0)
+                target = laneActive(i, now) ? std::max<uint32_t>(1, budget * target / activeShare) : 1;
+            if (target != lane_prefetch[i]) {
+                channel_input->BasicQos(consume_tags[i], target);
+                lane_prefetch[i] = target;
+                Metrics::counter("consumer.rebalance").add();
+            }
+        }
+    }
+
+    /**
+     * @brief 以指数退避重试直至连接成功或进程开始退出，记录停机时长
+     */
+    void reconnect() {
+        auto start = std::chrono::steady_clock::now();
+        Backoff backoff;
+        while (!stopping) {
+            try {
+                connect();
+                break;
+            }
+            catch (const std::exception &e) {
+                std::cerr << getCurrentTime() << "Consumer connect failed (attempt " << backoff.attempts() + 1
+                          << "): " << e.what() << std::endl;
+                backoff.wait(&stopping);
+            }
+        }
+        if (connected && generation > 1) {
+            Metrics::counter("consumer.reconnect").add();
+            Metrics::timer("consumer.reconnect_downtime").record(Metrics::elapsedUs(start));
+        }
+    }
 
 public:
-    RabbitMQPull() // 声明队列
-    : channel_input(Channel::Create(MQ_HOST, MQ_PORT, MQ_USER, MQ_PASSWORD))
+    /**
+     * @param subscriptions 订阅的输入队列，靠前的优先消费；
+     *        各队列的预取窗口即其可占用的处理槽位，每确认一条，broker 才补发一条
+     * @param stopping 置位后停止重连，连接断开时 pullTaskData() / drain() 立即返回 false
+     */
+    RabbitMQPull(const std::vector<QueueSubscription> &subscriptions, const std::atomic<bool> &stopping)
+    : subscriptions(subscriptions), stopping(stopping)
     {
-        channel_input->DeclareQueue(queue_input, false, true, false, false);
+        reconnect();
     };
 
-    ~RabbitMQPull() {};
+    ~RabbitMQPull() override {};
 
     /**
-     * @brief 拉取任务数据 
-     * @param taskData 任务数据
+     * @brief 拉取任务数据，阻塞等待直至收到消息或超时
+     * 先按优先级依次检查各队列已到达的消息，都没有时再阻塞等待任意队列；
+     * 连接或通道异常时重建连接、重新声明队列并注册消费者
+     * @param message 拉取到的消息
+     * @param timeout 等待超时（毫秒）
      * @return 是否成功
      */
-    bool pullTaskData(json &taskData) {
-        std::string consume_tag = channel_input->BasicConsume(
-            queue_input, "", true,
-            true,/* no_ack */
-            false/* exclusive */
-        );
+    bool pullTaskData(TaskMessage &message, int timeout = MQ_CONSUME_TIMEOUT) override {
         Envelope::ptr_t envelope;
-        bool flag = channel_input->BasicConsumeMessage(consume_tag, envelope);
-        channel_input->BasicCancel(consume_tag);  // 释放消费者
-        if(!flag) return false;
+        if (!connected) // 退出期间放弃重连
+            return false;
+        try {
+            flushAcks();
+            // 仍有未确认任务时缩短等待，保证 ack 及时送达以释放预取窗口
+            if (unacked > 0)
+                timeout = std::min(timeout, MQ_ACK_INTERVAL);
+
+            bool flag = false;
+            for (auto &tag : consume_tags) {
+                if ((flag = channel_input->BasicConsumeMessage(tag, envelope, 0)))
+                    break;
+            }
+            if (subscriptions.size() > 1 &&
+                std::chrono::steady_clock::now() - rebalanced > std::chrono::milliseconds(MQ_CONSUME_TIMEOUT))
+                rebalance();
+            if (!flag && !channel_input->BasicConsumeMessage(consume_tags, envelope, timeout))
+                return false;
 
-        std::string message = envelope->Message()->Body();
-        taskData = json::parse(message);
+            // 空闲通道收到消息，立即收回借出的窗口
+            size_t index = tag_index[envelope->ConsumerTag()];
+            bool wasIdle = !laneActive(index, std::chrono::steady_clock::now());
+            lane_active[index] = std::chrono::steady_clock::now();
+            if (wasIdle && subscriptions.size() > 1)
+                rebalance();
+        }
+        catch (const std::exception &e) {
+            std::cerr << getCurrentTime() << "Consumer lost: " << e.what() << std::endl;
+            connected = false;
+            reconnect();
+            return false;
+        }
+
+        BasicMessage::ptr_t body = envelope->Message();
+        message.body = body->Body();
+        message.delivery.tag = envelope->DeliveryTag();
+        message.delivery.channel = envelope->DeliveryChannel();
+        message.delivery.generation = generation;
+        message.lane = tag_lane[envelope->ConsumerTag()];
+        message.timestamp = body->TimestampIsSet() ? body->Timestamp() : 0;
+        message.reply.queue = body->ReplyToIsSet() ? body->ReplyTo() : "";
+        message.reply.correlationId = body->CorrelationIdIsSet() ? body->CorrelationId() : "";
+        message.contentType = body->ContentTypeIsSet() ? body->ContentType() : "";
+        message.contentEncoding = body->ContentEncodingIsSet() ? body->ContentEncoding() : "";
+        message.received = std::chrono::steady_clock::now();
+        unacked++;
         return true;
     };
+
+    /**
+     * @brief 停止消费并等待已拉取的任务全部确认
+     * 取消消费者后 broker 不再投递；预取但未取出的消息在通道关闭时由 broker 重新入队
+     * @param deadline 最迟等待时间
+     * @return 截止前全部确认返回 true
+     */
+    bool drain(std::chrono::steady_clock::time_point deadline) override {
+        if (!connected)
+            return false;
+        try {
+            for (auto &tag : consume_tags)
+                channel_input->BasicCancel(tag);
+            while (true) {
+                flushAcks();
+                if (unacked <= 0)
+                    return true;
+                if (std::chrono::steady_clock::now() > deadline)
+                    return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(MQ_ACK_INTERVAL));
+            }
+        }
+        catch (const std::exception &e) { // 连接已断开，未确认的任务由 broker 重新投递
+            std::cerr << getCurrentTime() << "Drain failed: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    /**
+     * @brief 回报任务处理结果（线程安全），实际确认在拉取线程中发送
+     * @param delivery 投递信息
+     * @param success 结果已回送则 ack，否则 reject 并重新入队
+     */
+    void ack(const Delivery &delivery, bool success = true) override {
+        std::lock_guard<std::mutex> lock(ack_mutex);
+        pending_acks.emplace_back(delivery, success);
+    }
 };
 
 class RabbitMQPush {
 private:
     std::string queue_output = "CompileQueueOutput";
     Channel::ptr_t channel_output;
+    std::string compression = getSetting("RESULT_COMPRESSION", RESULT_COMPRESSION);
+    int chunk_threshold = getSetting("RESULT_CHUNK_THRESHOLD", RESULT_CHUNK_THRESHOLD);
+
+    /**
+     * @brief 建立连接并声明队列
+     */
+    void connect() {
+        channel_output = Channel::Create(MQ_HOST, MQ_PORT, MQ_USER, MQ_PASSWORD);
+        channel_output->DeclareQueue(queue_output, false, true, false, false);
+    }
 
 public:
     RabbitMQPush() // 声明队列
-    : channel_output(Channel::Create(MQ_HOST, MQ_PORT, MQ_USER, MQ_PASSWORD))
     {
-        channel_output->DeclareQueue(queue_output, false, true, false, false);
+        connect();
     };
 
     ~RabbitMQPush() {};
@@ -62,7 +331,230 @@ public:
      * @brief 推送任务数据
      */
     void pushTaskData(const json &taskData) {
-        BasicMessage::ptr_t message = BasicMessage::Create(taskData.dump());
-        channel_output->BasicPublish("", queue_output, message);
+        pushMessage(taskData.dump());
+    }
+
+    /**
+     * @brief 推送已序列化的消息；连接失效时以指数退避重连，
+     *        超过 MQ_RECONNECT_ATTEMPTS 次仍失败则抛出最后一次异常
+     * @param contentType 消息封装格式，为空时不设置（JSON）
+     */
+    void pushMessage(const std::string &body, const std::string &contentType = "") {
+        send(queue_output, body, contentType, "", false);
+    }
+
+    /**
+     * @brief 经默认交换机直接推送到调用方的应答队列，并带回 correlation_id
+     * 以 mandatory 发布：应答队列不存在（调用方已断开）时 broker 退回消息，抛出 MessageReturnedException
+     */
+    void pushReply(const ReplyAddress &reply, const std::string &body, const std::string &contentType = "") {
+        send(reply.queue, body, contentType, reply.correlationId, true);
+    }
+
+private:
+    /**
+     * @brief 发送一条结果：超过 RESULT_CHUNK_THRESHOLD 时分片发送；
+     *        启用压缩且超过 RESULT_COMPRESS_MIN 时按自适应级别 gzip 压缩
+     * @param mandatory 无法路由到队列时由 broker 退回并抛出异常
+     */
+    void send(const std::string &routing_key, const std::string &body, const std::string &contentType,
+              const std::string &correlationId, bool mandatory) {
+        bool compress = compression == "gzip" && body.size() >= RESULT_COMPRESS_MIN;
+        if (chunk_threshold > 0 && body.size() > (size_t)chunk_threshold) {
+            sendChunked(routing_key, body, contentType, compress, correlationId, mandatory);
+            return;
+        }
+
+        std::string compressed;
+        const std::string *payload = &body;
+        if (compress) {
+            auto start = std::chrono::steady_clock::now();
+            compressed = Compression::gzip(body, Compression::adaptiveLevel(body.size()));
+            Metrics::timer("publisher.compress").record(Metrics::elapsedUs(start));
+            // 压缩无收益（如已压缩的产物）时按原样发送
+            if (compressed.size() < body.size()) {
+                Metrics::summary("publisher.compress_ratio").record(compressed.size() * 100 / body.size());
+                payload = &compressed;
+            }
+        }
+        BasicMessage::ptr_t message = BasicMessage::Create(*payload);
+        if (!contentType.empty())
+            message->ContentType(contentType);
+        if (payload == &compressed)
+            message->ContentEncoding("gzip");
+        if (!correlationId.empty())
+            message->CorrelationId(correlationId);
+        publish(routing_key, message, mandatory);
+    }
+
+    /**
+     * @brief 分片发送：边压缩边切分，按序发送各分片，最后发送清单；
+     *        内存中只有完整消息体与一个分片，不生成完整的压缩结果
+     * 分片与清单共用 x-transfer-id 头，分片带 x-chunk-index；分片的 content-type / content-encoding
+     * 描述拼接后的消息体，清单（x-transfer-manifest）的消息体为 JSON {transfer, chunks, size}。
+     * 中途失败时整条结果由调用方暂存重发，消费端丢弃没有清单的传输
+     * @param compress 是否以 gzip 流压缩
+     */
+    void sendChunked(const std::string &routing_key, const std::string &body, const std::string &contentType,
+                     bool compress, const std::string &correlationId, bool mandatory) {
+        std::string transfer = transferID();
+        int32_t chunks = 0;
+        size_t size = 0;
+        auto emit = [&](const std::string &piece) {
+            BasicMessage::ptr_t chunk = BasicMessage::Create(piece);
+            if (!contentType.empty())
+                chunk->ContentType(contentType);
+            if (compress)
+                chunk->ContentEncoding("gzip");
+            if (!correlationId.empty())
+                chunk->CorrelationId(correlationId);
+            Table headers;
+            headers["x-transfer-id"] = transfer;
+            headers["x-chunk-index"] = chunks++;
+            chunk->HeaderTable(headers);
+            publish(routing_key, chunk, mandatory);
+            size += piece.size();
+        };
+
+        size_t chunkSize = RESULT_CHUNK_SIZE;
+        if (compress) {
+            auto start = std::chrono::steady_clock::now();
+            Compression::gzipChunks(body, Compression::adaptiveLevel(body.size()), chunkSize, emit);
+            Metrics::timer("publisher.compress").record(Metrics::elapsedUs(start));
+            Metrics::summary("publisher.compress_ratio").record(size * 100 / body.size());
+        }
+        else {
+            std::string piece; // 复用同一缓冲区
+            for (size_t offset = 0; offset < body.size(); offset += chunkSize) {
+                piece.assign(body, offset, chunkSize);
+                emit(piece);
+            }
+        }
+
+        json manifest = {{"transfer", transfer}, {"chunks", chunks}, {"size", size}};
+        BasicMessage::ptr_t message = BasicMessage::Create(manifest.dump());
+        message->ContentType("application/json");
+        if (!correlationId.empty())
+            message->CorrelationId(correlationId);
+        Table headers;
+        headers["x-transfer-id"] = transfer;
+        headers["x-transfer-manifest"] = true;
+        message->HeaderTable(headers);
+        publish(routing_key, message, mandatory);
+
+        Metrics::counter("publisher.chunked").add();
+        Metrics::summary("publisher.chunks").record(chunks);
+    }
+
+    /**
+     * @brief 生成随机的传输 ID（32 位十六进制）
+     */
+    static std::string transferID() {
+        thread_local std::mt19937_64 rng(std::random_device{}());
+        std::ostringstream id;
+        id << std::hex << std::setfill('0') << std::setw(16) << rng() << std::setw(16) << rng();
+        return id.str();
+    }
+
+    void publish(const std::string &routing_key, BasicMessage::ptr_t message, bool mandatory) {
+        std::chrono::steady_clock::time_point start;
+        Backoff backoff;
+        while (true) {
+            try {
+                if (!channel_output)
+                    connect();
+                channel_output->BasicPublish("", routing_key, message, mandatory);
+                break;
+            }
+            catch (const MessageReturnedException &) { // 无法路由，重连无益，通道仍可用
+                Metrics::counter("publisher.returned").add();
+                throw;
+            }
+            catch (const std::exception &e) {
+                if (backoff.attempts() == 0)
+                    start = std::chrono::steady_clock::now();
+                channel_output.reset(); // 丢弃失效通道
+                std::cerr << getCurrentTime() << "Publisher reconnect (attempt " << backoff.attempts() + 1
+                          << "): " << e.what() << std::endl;
+                if (backoff.attempts() >= MQ_RECONNECT_ATTEMPTS)
+                    throw;
+                backoff.wait();
+            }
+        }
+        if (backoff.attempts() > 0) {
+            Metrics::counter("publisher.reconnect").add();
+            Metrics::timer("publisher.reconnect_downtime").record(Metrics::elapsedUs(start));
+        }
+    }
+};
+
+class RabbitMQPushPool : public ResultSink {
+private:
+    std::mutex pool_mutex;
+    std::vector<std::unique_ptr<RabbitMQPush>> idle; // 空闲的长连接通道
+
+    /**
+     * @brief 借出一个推送通道，无空闲时新建
+     */
+    std::unique_ptr<RabbitMQPush> lease() {
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if (!idle.empty()) {
+                auto worker = std::move(idle.back());
+                idle.pop_back();
+                return worker;
+            }
+        }
+        Metrics::counter("publisher.connect").add();
+        return std::unique_ptr<RabbitMQPush>(new RabbitMQPush);
+    }
+
+    /**
+     * @brief 归还推送通道，超出池容量的直接关闭
+     */
+    void release(std::unique_ptr<RabbitMQPush> worker) {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (idle.size() < MQ_PUBLISHER_POOL_SIZE)
+            idle.push_back(std::move(worker));
+    }
+
+public:
+    RabbitMQPushPool() {};
+
+    ~RabbitMQPushPool() override {};
+
+    /**
+     * @brief 全局共享的推送通道池
+     */
+    static RabbitMQPushPool &instance() {
+        static RabbitMQPushPool pool;
+        return pool;
+    }
+
+    /**
+     * @brief 借用池中通道推送任务数据；通道失效时由 RabbitMQPush 自行重连
+     */
+    void pushTaskData(const json &taskData) {
+        pushMessage(taskData.dump(), "");
     }
-};
\ No newline at end of file
+
+    /**
+     * @brief 借用池中通道推送已序列化的消息
+     */
+    void pushMessage(const std::string &body, const std::string &contentType) override {
+        Metrics::Scope scope(Metrics::timer("publisher.latency"));
+        auto worker = lease();
+        worker->pushMessage(body, contentType);
+        release(std::move(worker));
+    }
+
+    /**
+     * @brief 借用池中通道推送交互式请求的应答
+     */
+    void pushReply(const ReplyAddress &reply, const std::string &body, const std::string &contentType) override {
+        Metrics::Scope scope(Metrics::timer("publisher.reply_latency"));
+        auto worker = lease();
+        worker->pushReply(reply, body, contentType);
+        release(std::move(worker));
+    }
+};
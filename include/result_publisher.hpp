@@ -0,0 +1,303 @@
+#pragma once
+
+#include <condition_variable>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include "transport.hpp"
+#include "message_codec.hpp"
+#include "mpsc_queue.hpp"
+#include "metrics.hpp"
+#include "result_spool.hpp"
+#include "task_index.hpp"
+
+// 结果回送线程：工作线程将结果放入无锁队列后立即返回，
+// 由单独线程按批取出，交给推送窗口并行推送，推送成功后再确认对应的输入消息
+// SimpleAmqpClient 在 BasicPublish 内同步等待确认，单通道无法流水线化；
+// 推送窗口由 MQ_PUBLISH_WINDOW 个线程组成，各自借用一个推送通道，同时最多有该数量的确认在途
+// 推送失败时结果写入本地暂存并确认输入消息，避免重复编译；暂存由重放线程按顺序补发
+// 带回送地址的交互式请求走独立队列，优先于批量结果直接推送到调用方的应答队列
+
+class ResultPublisher
+{
+private:
+    struct Item
+    {
+        std::string taskID;
+        json taskData;
+        std::string body; // 序列化后的结果
+        TaskSource *source = nullptr;
+        Delivery delivery;
+        ReplyAddress reply;
+        std::string contentType; // 回送格式，与输入消息一致
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    MPSCQueue<Item> queue;
+    MPSCQueue<Item> replies; // 交互式请求的应答，优先推送
+    std::atomic<bool> running{true};
+    std::atomic<bool> idle{false};
+    std::atomic<std::time_t> deferred{0}; // 最近一次重放暂存结果的时间
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    ResultSink &sink;
+    ResultSpool spool;
+
+    // 推送窗口：当前批次由窗口线程并行处理，回送线程等待整批完成
+    std::mutex batch_mutex;
+    std::condition_variable batch_ready;
+    std::condition_variable batch_done;
+    std::vector<Item> batch;
+    size_t next = 0;     // 下一条待领取的结果
+    size_t finished = 0; // 已处理完的结果数
+    bool closing = false;
+    std::vector<std::thread> window;
+
+    std::thread worker;
+    std::thread replayer;
+
+    /**
+     * @brief 回送一条结果；暂存非空时直接追加到暂存，保证回送顺序
+     * @return 结果已推送或已落盘
+     */
+    bool deliver(const std::string &body, const std::string &contentType)
+    {
+        if (spool.empty())
+        {
+            try
+            {
+                sink.pushMessage(body, contentType);
+                return true;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << getCurrentTime() << "Push back failed, spooling: " << e.what() << std::endl;
+            }
+        }
+        if (spool.append(MessageCodec::pack(contentType, body)))
+        {
+            Metrics::counter("spool.append").add();
+            return true;
+        }
+        std::cerr << getCurrentTime() << "Spool full" << std::endl;
+        return false;
+    }
+
+    /**
+     * @brief 重放线程：连接恢复后按写入顺序补发暂存的结果
+     */
+    void replay()
+    {
+        while (running)
+        {
+            std::string record, contentType, body;
+            while (running && spool.front(record))
+            {
+                MessageCodec::unpack(record, contentType, body);
+                try
+                {
+                    sink.pushMessage(body, contentType);
+                }
+                catch (const std::exception &e)
+                { // broker 仍不可达，稍后重试
+                    break;
+                }
+                spool.pop();
+                deferred = std::time(nullptr);
+                Metrics::counter("spool.replay").add();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(SPOOL_REPLAY_INTERVAL));
+        }
+    }
+
+    /**
+     * @brief 推送应答；应答队列不可达（调用方已断开，mandatory 消息被 broker 退回）时退回普通回送路径，结果不丢失
+     */
+    bool deliverReply(const ReplyAddress &reply, const std::string &body, const std::string &contentType)
+    {
+        try
+        {
+            sink.pushReply(reply, body, contentType);
+            return true;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << getCurrentTime() << "Reply to " << reply.queue << " failed: " << e.what() << std::endl;
+        }
+        return deliver(body, contentType);
+    }
+
+    /**
+     * @brief 推送一条结果并确认对应的输入消息
+     */
+    void process(Item &it)
+    {
+        // 缺少附加文件的结果不记录，上游补发后重新处理
+        bool final = it.taskData["task"]["status"] != "MISSING_ASSETS";
+        // 序列化后立即释放 DOM，推送期间只保留消息体
+        it.body = MessageCodec::encode(it.taskData, it.contentType);
+        it.taskData = json();
+
+        // 推送与暂存均失败时任务重新入队
+        bool success = it.reply.empty() ? deliver(it.body, it.contentType)
+                                        : deliverReply(it.reply, it.body, it.contentType);
+        Metrics::timer(it.reply.empty() ? "publisher.queue_wait" : "publisher.reply_wait").record(Metrics::elapsedUs(it.enqueued));
+        it.source->ack(it.delivery, success);
+        it.body.clear();
+
+        // 记录任务已完成，并确认处理期间挂起的重复投递；应答只到了调用方，不记录，之后的同 ID 投递重新处理
+        auto waiters = success && final && it.reply.empty() ? TaskIndex::instance().complete(it.taskID)
+                                                            : TaskIndex::instance().abandon(it.taskID);
+        for (auto &[source, waiter] : waiters)
+            source->ack(waiter, success);
+    }
+
+    /**
+     * @brief 推送所有待发的应答
+     */
+    void flushReplies()
+    {
+        Item item;
+        while (replies.pop(item))
+            process(item);
+    }
+
+    /**
+     * @brief 窗口线程：领取当前批次中的结果并推送，每个线程同时只有一条确认在途
+     */
+    void confirm()
+    {
+        std::unique_lock<std::mutex> lock(batch_mutex);
+        while (true)
+        {
+            batch_ready.wait(lock, [this]
+                             { return next < batch.size() || closing; });
+            if (next >= batch.size())
+                return;
+            Item &it = batch[next++];
+            lock.unlock();
+            process(it);
+            lock.lock();
+            if (++finished == batch.size())
+                batch_done.notify_one();
+        }
+    }
+
+    void run()
+    {
+        std::vector<Item> pending;
+        pending.reserve(MQ_PUBLISH_BATCH);
+        while (running || !queue.empty() || !replies.empty())
+        {
+            flushReplies();
+
+            Item item;
+            while (pending.size() < MQ_PUBLISH_BATCH && queue.pop(item))
+                pending.push_back(std::move(item));
+
+            if (pending.empty())
+            { // 队列空闲，等待唤醒（超时兜底）
+                std::unique_lock<std::mutex> lock(wake_mutex);
+                idle = true;
+                wake.wait_for(lock, std::chrono::milliseconds(MQ_ACK_INTERVAL),
+                              [this]
+                              { return !queue.empty() || !replies.empty() || !running; });
+                idle = false;
+                continue;
+            }
+
+            Metrics::summary("publisher.batch_size").record(pending.size());
+            std::unique_lock<std::mutex> lock(batch_mutex);
+            batch.swap(pending);
+            next = finished = 0;
+            batch_ready.notify_all();
+            // 等待窗口处理整批，期间应答由本线程直接推送，不排在批量结果之后
+            while (finished < batch.size())
+            {
+                if (replies.empty())
+                {
+                    batch_done.wait_for(lock, std::chrono::milliseconds(MQ_ACK_INTERVAL));
+                    continue;
+                }
+                lock.unlock();
+                flushReplies();
+                lock.lock();
+            }
+            batch.clear();
+            batch.swap(pending);
+        }
+    }
+
+public:
+    /**
+     * @param sink 结果去向
+     */
+    ResultPublisher(ResultSink &sink) : sink(sink),
+                                        spool(fs::path(FILE_ROOT_PATH) / SPOOL_FILE, SPOOL_CAPACITY)
+    {
+        for (int i = 0; i < std::max(1, getSetting("MQ_PUBLISH_WINDOW", MQ_PUBLISH_WINDOW)); i++)
+            window.emplace_back(&ResultPublisher::confirm, this);
+        worker = std::thread(&ResultPublisher::run, this);
+        replayer = std::thread(&ResultPublisher::replay, this);
+    }
+
+    ~ResultPublisher()
+    {
+        running = false;
+        wake.notify_one();
+        worker.join();
+        replayer.join();
+        {
+            std::lock_guard<std::mutex> lock(batch_mutex);
+            closing = true;
+        }
+        batch_ready.notify_all();
+        for (auto &thread : window)
+            thread.join();
+    }
+
+    /**
+     * @brief 提交待回送的任务结果（线程安全，不阻塞）
+     * @param taskData 任务数据
+     * @param source 消息来源，推送完成后在其上确认
+     * @param delivery 投递信息
+     * @param reply 回送地址，非空时直接推送到调用方的应答队列
+     * @param contentType 回送格式，为空表示 JSON
+     */
+    void submit(json &&taskData, TaskSource *source, const Delivery &delivery, const ReplyAddress &reply = ReplyAddress(),
+                const std::string &contentType = "")
+    {
+        Item item;
+        item.taskID = taskData["task"]["id"];
+        item.taskData = std::move(taskData);
+        item.source = source;
+        item.delivery = delivery;
+        item.reply = reply;
+        item.contentType = contentType;
+        enqueue(std::move(item));
+    }
+
+    /**
+     * @brief 最近一次经暂存延迟回送结果的时间；暂存非空时为当前时间
+     */
+    std::time_t lastDeferred()
+    {
+        return spool.empty() ? deferred.load() : std::time(nullptr);
+    }
+
+private:
+    void enqueue(Item &&item)
+    {
+        item.enqueued = std::chrono::steady_clock::now();
+        if (item.reply.empty())
+            queue.push(std::move(item));
+        else
+            replies.push(std::move(item));
+        if (idle)
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            wake.notify_one();
+        }
+    }
+};
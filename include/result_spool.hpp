@@ -0,0 +1,195 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compile_settings.h"
+
+namespace fs = boost::filesystem;
+
+// 结果暂存：broker 不可达时，把待回送的结果追加到本地内存映射环形文件，恢复后按顺序重放
+// 文件布局：首页为 Header，其后为 capacity 字节的环形数据区；
+// 每条记录为 4 字节长度 + 消息体，head / tail 为单调递增的逻辑偏移
+// 同一主机上新旧进程交接时可能同时运行，每个进程以文件锁独占一个暂存槽位（path、path.1、path.2 ...）
+
+class ResultSpool
+{
+private:
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t capacity;
+        uint64_t head; // 最早一条记录的起点
+        uint64_t tail; // 下一条记录的写入点
+    };
+
+    static constexpr uint64_t MAGIC = 0x4a43535031ULL; // "JCSP1"
+
+    std::mutex mutex;
+    int fd = -1;
+    size_t pageSize;
+    size_t mapSize = 0;
+    char *base = nullptr;
+    Header *header = nullptr;
+    char *data = nullptr;
+
+    /**
+     * @brief 把映射区内 [offset, offset + len) 所在的页同步到磁盘
+     */
+    void sync(size_t offset, size_t len)
+    {
+        size_t begin = offset / pageSize * pageSize;
+        msync(base + begin, offset + len - begin, MS_SYNC);
+    }
+
+    /**
+     * @brief 按逻辑偏移写入数据区，跨越末尾时回绕
+     */
+    void write(uint64_t pos, const char *src, size_t len)
+    {
+        uint64_t offset = pos % header->capacity;
+        size_t first = std::min<uint64_t>(len, header->capacity - offset);
+        std::memcpy(data + offset, src, first);
+        std::memcpy(data, src + first, len - first);
+        sync(pageSize + offset, first);
+        if (len > first)
+            sync(pageSize, len - first);
+    }
+
+    void read(uint64_t pos, char *dst, size_t len) const
+    {
+        uint64_t offset = pos % header->capacity;
+        size_t first = std::min<uint64_t>(len, header->capacity - offset);
+        std::memcpy(dst, data + offset, first);
+        std::memcpy(dst + first, data, len - first);
+    }
+
+public:
+    /**
+     * @param path 暂存文件路径
+     * @param capacity 数据区容量（字节），仅在新建文件时生效
+     */
+    ResultSpool(const fs::path &path, uint64_t capacity) : pageSize(sysconf(_SC_PAGESIZE))
+    {
+        fs::create_directories(path.parent_path());
+        for (int slot = 0; slot < SPOOL_SLOTS && fd == -1; slot++)
+        {
+            fs::path slotPath = path;
+            if (slot > 0)
+                slotPath += "." + std::to_string(slot);
+            fd = open(slotPath.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd != -1 && flock(fd, LOCK_EX | LOCK_NB) != 0)
+            { // 槽位被其他进程占用
+                close(fd);
+                fd = -1;
+            }
+        }
+        if (fd == -1)
+            throw std::runtime_error("Cannot open spool file");
+
+        struct stat st;
+        fstat(fd, &st);
+        if ((uint64_t)st.st_size > pageSize)
+        { // 沿用已有文件的容量，保留未重放的记录
+            Header existing;
+            if (pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) && existing.magic == MAGIC)
+                capacity = existing.capacity;
+        }
+        mapSize = pageSize + capacity;
+        if ((uint64_t)st.st_size < mapSize && ftruncate(fd, mapSize) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot resize spool file");
+        }
+
+        void *addr = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot map spool file");
+        }
+        base = static_cast<char *>(addr);
+        header = reinterpret_cast<Header *>(base);
+        data = base + pageSize;
+
+        if (header->magic != MAGIC)
+        { // 新文件
+            header->magic = MAGIC;
+            header->capacity = capacity;
+            header->head = header->tail = 0;
+            sync(0, sizeof(Header));
+        }
+    }
+
+    ~ResultSpool()
+    {
+        munmap(base, mapSize);
+        close(fd);
+    }
+
+    ResultSpool(const ResultSpool &) = delete;
+    ResultSpool &operator=(const ResultSpool &) = delete;
+
+    /**
+     * @brief 追加一条记录，落盘后才返回
+     * @return 空间不足时返回 false
+     */
+    bool append(const std::string &payload)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t need = sizeof(uint32_t) + payload.size();
+        if (header->tail - header->head + need > header->capacity)
+            return false;
+
+        uint32_t len = payload.size();
+        write(header->tail, reinterpret_cast<const char *>(&len), sizeof(len));
+        write(header->tail + sizeof(len), payload.data(), payload.size());
+        // 记录落盘后再推进 tail，崩溃时不会读到半条记录
+        header->tail += need;
+        sync(0, sizeof(Header));
+        return true;
+    }
+
+    /**
+     * @brief 读取最早的一条记录（不移除）
+     * @return 暂存为空时返回 false
+     */
+    bool front(std::string &payload)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (header->head == header->tail)
+            return false;
+        uint32_t len;
+        read(header->head, reinterpret_cast<char *>(&len), sizeof(len));
+        payload.resize(len);
+        read(header->head + sizeof(len), &payload[0], len);
+        return true;
+    }
+
+    /**
+     * @brief 移除最早的一条记录
+     */
+    void pop()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (header->head == header->tail)
+            return;
+        uint32_t len;
+        read(header->head, reinterpret_cast<char *>(&len), sizeof(len));
+        header->head += sizeof(len) + len;
+        sync(0, sizeof(Header));
+    }
+
+    bool empty()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return header->head == header->tail;
+    }
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <openssl/evp.h>
+#include <stdexcept>
+#include <string>
+
+// SHA-256（OpenSSL libcrypto），支持边读边算
+
+class Sha256
+{
+private:
+    EVP_MD_CTX *ctx;
+
+public:
+    Sha256() : ctx(EVP_MD_CTX_new())
+    {
+        if (ctx == nullptr || EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1)
+            throw std::runtime_error("SHA-256 init failed");
+    }
+
+    ~Sha256()
+    {
+        EVP_MD_CTX_free(ctx);
+    }
+
+    Sha256(const Sha256 &) = delete;
+    Sha256 &operator=(const Sha256 &) = delete;
+
+    void update(const void *data, size_t size)
+    {
+        EVP_DigestUpdate(ctx, data, size);
+    }
+
+    void update(const std::string &data)
+    {
+        update(data.data(), data.size());
+    }
+
+    /**
+     * @brief 结束计算
+     * @return 64 位小写十六进制摘要
+     */
+    std::string hex()
+    {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int len = 0;
+        EVP_DigestFinal_ex(ctx, digest, &len);
+
+        static const char digits[] = "0123456789abcdef";
+        std::string out(len * 2, '0');
+        for (unsigned int i = 0; i < len; i++)
+        {
+            out[i * 2] = digits[digest[i] >> 4];
+            out[i * 2 + 1] = digits[digest[i] & 0xf];
+        }
+        return out;
+    }
+
+    /**
+     * @brief 计算一段数据的摘要
+     */
+    static std::string of(const std::string &data)
+    {
+        Sha256 sha;
+        sha.update(data);
+        return sha.hex();
+    }
+};
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "compile_settings.h"
+#include "transport.hpp"
+#include "metrics.hpp"
+#include "sha256.hpp"
+
+namespace fs = boost::filesystem;
+
+// 任务索引：记录近期完成的任务 ID 及其内容指纹（内存 LRU + 磁盘），以及正在处理的任务
+// 指纹为语言、代码与附加文件的 sha256，同 ID 但内容不同（如修改附加文件后重判）的任务重新编译
+// 重复投递的已完成任务（结果已回送）直接确认；与进行中的任务重复时挂到该任务上，随其结果一并确认；
+// 不能复用进行中任务结果的（重判、交互式请求或内容不同）推迟到该任务结束后重新处理
+
+class TaskIndex
+{
+public:
+    enum class State
+    {
+        STARTED,  // 首次出现，由调用方处理
+        DONE,     // 已完成且结果已回送
+        ATTACHED, // 与进行中的任务重复，已挂起等待其完成
+        DEFERRED, // 同 ID 任务进行中但不能复用其结果，该任务结束后调用 retry 重新处理
+    };
+
+    // 挂起的重复投递：消息来源与投递信息
+    typedef std::vector<std::pair<TaskSource *, Delivery>> Waiters;
+
+private:
+    struct Running
+    {
+        std::string fingerprint;
+        bool reply; // 结果只回送到调用方（应答队列或同步接口），重复投递不能以它作答
+        Waiters waiters;
+        std::vector<std::function<void()>> deferred;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Running> inflight;
+
+    // 内存中的最近完成记录（任务 ID, 指纹），最近使用的在前
+    std::list<std::pair<std::string, std::string>> recent;
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> recentIndex;
+
+    fs::path dir;
+
+    /**
+     * @brief 任务 ID 可作为文件名时返回对应路径，否则返回空路径（仅保存在内存）
+     */
+    fs::path pathOf(const std::string &taskID) const
+    {
+        if (taskID.empty() || taskID.find_first_of("/\\") != std::string::npos || taskID[0] == '.')
+            return fs::path();
+        return dir / (taskID + ".sha256");
+    }
+
+    /**
+     * @brief 标记任务进行中（调用方持有锁）
+     */
+    void start(const std::string &taskID, const std::string &fingerprint, bool reply)
+    {
+        inflight[taskID].fingerprint = fingerprint;
+        inflight[taskID].reply = reply;
+        // 本进程中没有同 ID 的任务在处理，残留的任务目录来自上次异常退出
+        fs::path taskDir(FILE_ROOT_PATH + taskID);
+        if (!pathOf(taskID).empty() && fs::exists(taskDir))
+            fs::remove_all(taskDir);
+    }
+
+    void remember(const std::string &taskID, std::string fingerprint)
+    {
+        auto it = recentIndex.find(taskID);
+        if (it != recentIndex.end())
+            recent.erase(it->second);
+        recent.emplace_front(taskID, std::move(fingerprint));
+        recentIndex[taskID] = recent.begin();
+        while (recent.size() > TASK_INDEX_MEMORY)
+        {
+            recentIndex.erase(recent.back().first);
+            recent.pop_back();
+        }
+    }
+
+    /**
+     * @brief 撤销进行中标记，释放锁后重新处理推迟的投递
+     * @return 挂起的重复投递
+     */
+    Waiters finish(std::unordered_map<std::string, Running>::iterator it, std::unique_lock<std::mutex> &lock)
+    {
+        Waiters waiters = std::move(it->second.waiters);
+        auto deferred = std::move(it->second.deferred);
+        inflight.erase(it);
+        lock.unlock();
+        for (auto &retry : deferred)
+            retry();
+        return waiters;
+    }
+
+    /**
+     * @brief 查询已完成任务的指纹（调用方持有锁）
+     */
+    bool recorded(const std::string &taskID, std::string &fingerprint)
+    {
+        auto it = recentIndex.find(taskID);
+        if (it != recentIndex.end())
+        {
+            fingerprint = it->second->second;
+            return true;
+        }
+        fs::path path = pathOf(taskID);
+        std::ifstream file(path.string());
+        if (path.empty() || !(file >> fingerprint))
+            return false;
+        remember(taskID, fingerprint);
+        return true;
+    }
+
+public:
+    TaskIndex() : dir(fs::path(FILE_ROOT_PATH) / TASK_INDEX_DIR)
+    {
+        fs::create_directories(dir);
+    }
+
+    ~TaskIndex() {};
+
+    static TaskIndex &instance()
+    {
+        static TaskIndex index;
+        return index;
+    }
+
+    /**
+     * @brief 任务内容指纹：语言、代码与附加文件（引用按哈希计入）的 sha256
+     */
+    static std::string fingerprint(const json &taskData)
+    {
+        Sha256 sha;
+        const json &answer = taskData.at("task").at("answer");
+        sha.update(answer.at("language").get_ref<const std::string &>());
+        sha.update("\0code\0", 6);
+        sha.update(answer.at("code").get_ref<const std::string &>());
+        auto extra = taskData.find("extra");
+        if (extra == taskData.end())
+            return sha.hex();
+        for (auto &element : *extra)
+        {
+            for (auto &item : element.items())
+            {
+                sha.update("\0extra\0", 7);
+                sha.update(item.key());
+                sha.update("\0", 1);
+                const json &value = item.value();
+                if (value.is_binary())
+                    sha.update(value.get_binary().data(), value.get_binary().size());
+                else if (value.is_string())
+                    sha.update(value.get_ref<const std::string &>());
+                else
+                    sha.update(value.dump());
+            }
+        }
+        return sha.hex();
+    }
+
+    /**
+     * @brief 登记一次投递
+     * @param taskID 任务 ID
+     * @param fingerprint 任务内容指纹
+     * @param reuse 是否接受已完成或进行中任务的结果；为 false 时（重判、交互式请求）总是重新处理
+     * @param reply 结果回送到调用方的应答队列，不挂起、也不被挂起，完成后应调用 abandon()
+     * @param source 消息来源
+     * @param delivery 投递信息
+     * @param retry 返回 DEFERRED 时保存，同 ID 任务结束后在 complete() / abandon() 的调用线程中执行
+     */
+    State begin(const std::string &taskID, const std::string &fingerprint, bool reuse, bool reply,
+                TaskSource *source, const Delivery &delivery, const std::function<void()> &retry)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto running = inflight.find(taskID);
+        if (running != inflight.end())
+        {
+            if (!reuse || reply || running->second.reply || running->second.fingerprint != fingerprint)
+            {
+                running->second.deferred.push_back(retry);
+                Metrics::counter("task_index.deferred").add();
+                return State::DEFERRED;
+            }
+            running->second.waiters.emplace_back(source, delivery);
+            Metrics::counter("task_index.attached").add();
+            return State::ATTACHED;
+        }
+
+        std::string done;
+        if (reuse && recorded(taskID, done) && done == fingerprint)
+        {
+            Metrics::counter("task_index.hit").add();
+            return State::DONE;
+        }
+
+        start(taskID, fingerprint, reply);
+        return State::STARTED;
+    }
+
+    /**
+     * @brief 登记一次不经消息来源的处理（同步编译接口），不查询、也不挂起到已有记录
+     * 结果直接交给调用方而未回送，完成后应调用 abandon()
+     * @return 同 ID 的任务正在处理时返回 false
+     */
+    bool claim(const std::string &taskID, const std::string &fingerprint)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (inflight.count(taskID))
+            return false;
+        start(taskID, fingerprint, true);
+        return true;
+    }
+
+    /**
+     * @brief 任务结果已回送，记录其指纹
+     * @return 期间挂起的重复投递
+     */
+    Waiters complete(const std::string &taskID)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = inflight.find(taskID);
+        if (it == inflight.end())
+            return Waiters();
+
+        fs::path path = pathOf(taskID);
+        if (!path.empty())
+        { // 先写临时文件再原子重命名
+            fs::path tmp = path;
+            tmp += ".tmp";
+            std::ofstream file(tmp.string());
+            file << it->second.fingerprint;
+            file.close();
+            if (file)
+                fs::rename(tmp, path);
+        }
+        remember(taskID, it->second.fingerprint);
+        return finish(it, lock);
+    }
+
+    /**
+     * @brief 任务未产生结果（格式错误、回送失败等），撤销进行中标记
+     * @return 期间挂起的重复投递
+     */
+    Waiters abandon(const std::string &taskID)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = inflight.find(taskID);
+        if (it == inflight.end())
+            return Waiters();
+        return finish(it, lock);
+    }
+
+    /**
+     * @brief 清理超过 TASK_INDEX_TTL 的磁盘记录
+     */
+    void expire()
+    {
+        std::time_t deadline = std::time(nullptr) - TASK_INDEX_TTL;
+        boost::system::error_code ec;
+        for (fs::directory_iterator itr(dir, ec), end; !ec && itr != end; itr.increment(ec))
+        {
+            if (fs::last_write_time(itr->path(), ec) < deadline)
+                fs::remove(itr->path(), ec);
+        }
+    }
+};
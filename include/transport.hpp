@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "compile_settings.h"
+
+// 传输层接口：消费线程经 TaskSource 拉取任务，回送线程经 ResultSink 推送结果
+// 实现：AMQP（rabbitmq_worker.hpp）、进程内队列（memory_transport.hpp）、Unix 域套接字（unix_transport.hpp）
+
+/**
+ * @brief 投递信息：连接重建后旧通道上的投递标签失效，以代数区分
+ */
+struct Delivery {
+    uint64_t tag = 0;
+    uint16_t channel = 0;
+    uint64_t generation = 0;
+};
+
+/**
+ * @brief 请求/应答模式的回送地址（AMQP reply_to / correlation_id），queue 为空表示普通任务
+ */
+struct ReplyAddress {
+    std::string queue;
+    std::string correlationId;
+
+    bool empty() const { return queue.empty(); }
+};
+
+/**
+ * @brief 拉取到的原始任务消息
+ */
+struct TaskMessage {
+    std::string body;                // 原始消息体，由工作线程解析
+    Delivery delivery;               // 投递信息，任务完成后交由 ack() 确认
+    std::string lane;                // 所属通道
+    uint64_t timestamp = 0;          // 生产者写入的 AMQP timestamp（秒），未设置为 0
+    ReplyAddress reply;              // 交互式请求的回送地址
+    std::string contentType;         // 消息封装格式，结果按同一格式回送（见 message_codec.hpp）
+    std::string contentEncoding;     // 消息体压缩方式，目前支持 "gzip"
+    std::chrono::steady_clock::time_point received; // 本地收到的时间
+};
+
+class TaskSource {
+public:
+    virtual ~TaskSource() {};
+
+    /**
+     * @brief 拉取任务数据，阻塞等待直至收到消息或超时
+     * @param message 拉取到的消息
+     * @param timeout 等待超时（毫秒）
+     * @return 是否成功
+     */
+    virtual bool pullTaskData(TaskMessage &message, int timeout = MQ_CONSUME_TIMEOUT) = 0;
+
+    /**
+     * @brief 回报任务处理结果（线程安全）
+     * @param delivery 投递信息
+     * @param success 结果已回送则确认，否则重新入队
+     */
+    virtual void ack(const Delivery &delivery, bool success = true) = 0;
+
+    /**
+     * @brief 停止消费并等待已拉取的任务全部确认
+     * @param deadline 最迟等待时间
+     * @return 截止前全部确认返回 true
+     */
+    virtual bool drain(std::chrono::steady_clock::time_point deadline) = 0;
+};
+
+class ResultSink {
+public:
+    virtual ~ResultSink() {};
+
+    /**
+     * @brief 推送已序列化的结果（线程安全），失败时抛出异常
+     * @param contentType 消息封装格式，为空表示 JSON
+     */
+    virtual void pushMessage(const std::string &body, const std::string &contentType) = 0;
+
+    /**
+     * @brief 将结果直接推送到调用方的应答队列（线程安全），失败时抛出异常
+     */
+    virtual void pushReply(const ReplyAddress &reply, const std::string &body, const std::string &contentType) = 0;
+};
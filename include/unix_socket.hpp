@@ -0,0 +1,110 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Unix 域套接字工具：帧格式为 4 字节大端长度 + 负载
+
+class UnixSocket
+{
+public:
+    /**
+     * @brief 在 path 上监听：先绑定到按 PID 区分的临时路径，再原子改名到 path，
+     *        替换已有的套接字（如交接中的旧进程）而不留下不可连接的间隙
+     * @param inode 输出本进程创建的套接字文件的 inode，退出时交给 release()
+     * @return 监听描述符
+     */
+    static int listenOn(const std::string &path, ino_t &inode)
+    {
+        std::string tmp = path + "." + std::to_string(getpid());
+        sockaddr_un addr{};
+        if (tmp.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("Socket path too long");
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, tmp.c_str(), sizeof(addr.sun_path) - 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == -1)
+            throw std::runtime_error("Socket failed");
+        unlink(tmp.c_str()); // 同 PID 的残留（容器重启后 PID 相同）
+        struct stat st;
+        if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0 ||
+            stat(tmp.c_str(), &st) != 0 || rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            close(fd);
+            unlink(tmp.c_str());
+            throw std::runtime_error("Cannot listen on " + path);
+        }
+        inode = st.st_ino;
+        return fd;
+    }
+
+    /**
+     * @brief 删除套接字文件，仅当 path 仍是本进程创建的那个（未被新进程替换）
+     */
+    static void release(const std::string &path, ino_t inode)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && st.st_ino == inode)
+            unlink(path.c_str());
+    }
+
+    /**
+     * @brief 读取一帧
+     * @return 连接关闭或出错时返回 false
+     */
+    static bool readFrame(int fd, std::string &payload)
+    {
+        uint32_t len;
+        if (!readFull(fd, reinterpret_cast<char *>(&len), sizeof(len)))
+            return false;
+        len = ntohl(len);
+        if (len > UNIX_FRAME_LIMIT)
+            return false;
+        payload.resize(len);
+        return readFull(fd, &payload[0], len);
+    }
+
+    /**
+     * @brief 写出一帧
+     * @return 连接关闭或出错时返回 false
+     */
+    static bool writeFrame(int fd, const std::string &payload)
+    {
+        uint32_t len = htonl(payload.size());
+        return writeFull(fd, reinterpret_cast<const char *>(&len), sizeof(len)) &&
+               writeFull(fd, payload.data(), payload.size());
+    }
+
+private:
+    static bool readFull(int fd, char *buffer, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t n = read(fd, buffer, len);
+            if (n <= 0)
+                return false;
+            buffer += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static bool writeFull(int fd, const char *buffer, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t n = send(fd, buffer, len, MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            buffer += n;
+            len -= n;
+        }
+        return true;
+    }
+};
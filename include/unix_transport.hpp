@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "memory_transport.hpp"
+#include "unix_socket.hpp"
+
+// Unix 域套接字 broker 替身：把进程内队列（MemoryBroker）暴露给同主机的其他进程，
+// 用于无 RabbitMQ 的单机部署。JudgeCompile 自身通过 MemoryTaskSource / MemoryResultSink 收发
+// 请求帧：1 字节操作码 + 队列名 + '\n' + 消息体
+//   'P' 投递消息体到队列，应答 "OK"；队列已满时应答 "FULL"，消息未入队，由调用方稍后重试
+//   'C' 从队列取一条消息（最多等待 MQ_CONSUME_TIMEOUT），应答 '1' + 消息体，超时应答 '0'
+// 同时服务的连接数不超过 UNIX_MAX_CONNECTIONS，超出的连接立即关闭；连接线程由 broker 持有，析构时关闭连接并等待其退出
+
+class UnixSocketBroker
+{
+private:
+    struct Client
+    {
+        int fd;      // 连接结束后置为 -1，析构时不会误关复用的描述符
+        bool done;   // 连接线程已结束，等待回收
+        std::thread thread;
+    };
+
+    std::string path;
+    ino_t inode; // 本进程创建的套接字文件
+    int listenFd;
+    std::atomic<bool> running{true};
+    std::thread acceptor;
+    std::mutex client_mutex;
+    std::map<uint64_t, Client> clients; // 活动连接及其线程，析构时关闭并等待
+    uint64_t nextClient = 0;
+
+    void serve(uint64_t id, int fd)
+    {
+        std::string request;
+        while (running && UnixSocket::readFrame(fd, request))
+        {
+            size_t pos = request.find('\n');
+            if (request.empty() || pos == std::string::npos)
+                break;
+            char op = request[0];
+            std::string queue = request.substr(1, pos - 1);
+
+            std::string response;
+            if (op == 'P')
+            {
+                bool accepted = MemoryBroker::instance().publish(queue, request.substr(pos + 1),
+                                                                 MemoryBroker::Overflow::REJECT);
+                response = accepted ? "OK" : "FULL";
+            }
+            else if (op == 'C')
+            {
+                std::string body;
+                size_t index;
+                if (MemoryBroker::instance().consume({queue}, body, index, MQ_CONSUME_TIMEOUT))
+                    response = "1" + body;
+                else
+                    response = "0";
+            }
+            else
+                break;
+
+            if (!UnixSocket::writeFrame(fd, response))
+                break;
+        }
+
+        std::lock_guard<std::mutex> lock(client_mutex);
+        close(fd);
+        auto it = clients.find(id);
+        if (it != clients.end())
+        {
+            it->second.fd = -1;
+            it->second.done = true;
+        }
+    }
+
+    /**
+     * @brief 回收已结束的连接线程，返回活动连接数（调用方持有锁）
+     */
+    size_t reap()
+    {
+        for (auto it = clients.begin(); it != clients.end();)
+        {
+            if (!it->second.done)
+            {
+                it++;
+                continue;
+            }
+            it->second.thread.join(); // 线程已置 done，只剩返回
+            it = clients.erase(it);
+        }
+        return clients.size();
+    }
+
+    void run()
+    {
+        int failures = 0;
+        while (running)
+        {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd == -1)
+            { // EMFILE 等错误会立即重复出现，连续失败时退避，最长 1.28 秒
+                if (running && errno != EINTR)
+                {
+                    Metrics::counter("transport.unix.accept_error").add();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10 << std::min(failures++, 7)));
+                }
+                continue;
+            }
+            failures = 0;
+            std::lock_guard<std::mutex> lock(client_mutex);
+            if (reap() >= UNIX_MAX_CONNECTIONS)
+            {
+                close(fd);
+                Metrics::counter("transport.unix.refused").add();
+                continue;
+            }
+            uint64_t id = nextClient++;
+            Client &client = clients[id];
+            client.fd = fd;
+            client.done = false;
+            client.thread = std::thread(&UnixSocketBroker::serve, this, id, fd);
+        }
+    }
+
+public:
+    UnixSocketBroker(const std::string &path) : path(path), listenFd(UnixSocket::listenOn(path, inode))
+    {
+        acceptor = std::thread(&UnixSocketBroker::run, this);
+        std::cout << getCurrentTime() << "Broker stand-in listening on " << path << std::endl;
+    }
+
+    /**
+     * @brief 停止接受连接，关闭活动连接并等待连接线程退出（阻塞在 consume 的最多等待 MQ_CONSUME_TIMEOUT）
+     */
+    ~UnixSocketBroker()
+    {
+        running = false;
+        shutdown(listenFd, SHUT_RDWR);
+        close(listenFd);
+        acceptor.join();
+        UnixSocket::release(path, inode);
+
+        std::map<uint64_t, Client> remaining;
+        {
+            std::lock_guard<std::mutex> lock(client_mutex);
+            for (auto &[id, client] : clients)
+            {
+                if (client.fd != -1)
+                    shutdown(client.fd, SHUT_RDWR);
+            }
+            remaining.swap(clients);
+        }
+        for (auto &[id, client] : remaining)
+            client.thread.join();
+    }
+};
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <boost/filesystem.hpp>
 #include <sys/wait.h>
 
+#include "compile_cache.hpp"
 #include "compile_interface.h"
 #include "compile_settings.h"
 #include "file_methods.hpp"
@@ -57,18 +58,27 @@ public:
         answerFile << answer["code"].get<std::string>();
     }
 
-    void compile() override
+    /**
+     * @brief iverilog 参数
+     */
+    std::vector<std::string> compileArgs()
     {
-        json extra = taskData["extra"];
+        return {"iverilog", "-o", "main", "main.v", "tb_main.v"};
+    }
+
+    std::string signature() override
+    {
+        return CompileCache::signature(compileArgs(), CompileCache::toolchainVersion("iverilog", "-V"));
+    }
 
+    void compile() override
+    {
         // iverilog
+        std::vector<std::string> argList = compileArgs();
         std::vector<const char *> args;
-        args.push_back("iverilog");
-        args.push_back("-o");
-        args.push_back("main");
-        args.push_back("main.v");
-        args.push_back("tb_main.v");
-        args.push_back(nullptr);
+        for (auto &arg : argList)
+            args.push_back(arg.c_str());
+        args.push_back(nullptr); // execvp 要求以 nullptr 结尾
 
         // pipe
         int pipefd[2];
@@ -87,6 +97,7 @@ public:
         }
         else if (pid == 0)
         {                     // 子进程
+            setpgid(0, 0);    // 自立进程组，取消时连同编译器派生的进程一并终止
             close(pipefd[0]); // 关闭读端
             dup2(pipefd[1], STDERR_FILENO);
             close(pipefd[1]);
@@ -107,9 +118,10 @@ public:
         else if (pid > 0)
         {                     // 父进程
             close(pipefd[1]); // 关闭写端
+            trackChild(pid);  // 登记子进程，取消时由 cancel() 终止
 
             int status;
-            waitpid(pid, &status, 0); // 等待子进程结束
+            waitChild(pid, status); // 等待子进程结束
 
             // 读取错误信息
             char buffer[1024];
@@ -120,6 +132,7 @@ public:
             }
             close(pipefd[0]);
 
+            checkCancelled();
             if (status != 0)
             { // 子进程本身出错
                 throw std::runtime_error("Compile failed");
@@ -139,11 +152,7 @@ public:
         {
             throw std::runtime_error("File not exists");
         }
-        std::string base64str;
-        Base64::EncodeFileToBase64(mainPath, base64str);
-        // 放入TaskData.task.result
-        json result;
-        result["main"] = base64str;
-        taskData["task"]["result"].push_back(result);
+        // 放入TaskData.task.result，哈希与大小记入TaskData.task.resultMeta
+        addResult(taskData, "main", mainPath);
     }
 };
\ No newline at end of file
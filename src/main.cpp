@@ -1,6 +1,18 @@
+#include <climits>
+#include <future>
+#include <map>
 #include <workspace/workspace.hpp>
 
 #include "rabbitmq_worker.hpp"
+#include "result_publisher.hpp"
+#include "task_index.hpp"
+#include "artifact_store.hpp"
+#include "asset_cache.hpp"
+#include "cancel_control.hpp"
+#include "memory_transport.hpp"
+#include "unix_transport.hpp"
+#include "compile_server.hpp"
+#include "metrics.hpp"
 #include "compile_settings.h"
 
 #include "compile_interface.h"
@@ -11,126 +23,606 @@
 #include "verilog_compile.hpp"
 #include "lua_compile.hpp"
 
-void work_func(json taskData);
+// 收到 SIGTERM / SIGINT 后置位，消费线程据此停止消费并等待任务完成
+std::atomic<bool> stopping{false};
+// 已建立连接并注册消费者的消费线程数，交接时等待全部就绪后才通知旧进程退出
+std::atomic<int> readyConsumers{0};
+
+// 在消费线程中创建任务来源
+typedef std::function<std::unique_ptr<TaskSource>()> SourceFactory;
+
+bool work_func(json &taskData, bool binary = false);
+void failTask(json &taskData, const std::string &status, const std::string &msg);
+void consume_loop(wsp::workbranch &branch, ResultPublisher &publisher, SourceFactory makeSource);
+void dispatch(wsp::workbranch &branch, std::shared_ptr<TaskMessage> message, TaskSource &mqWorker,
+              ResultPublisher &publisher);
+SourceFactory sourceFactory(const std::string &transport, const std::vector<QueueSubscription> &subscriptions);
+void preloadTasks(const std::string &path);
+pid_t handoffPidFile();
+std::string executableName(pid_t pid);
+std::vector<QueueSubscription> laneSubscriptions(int prefetch);
+std::vector<std::pair<std::string, int>> languageShards(const std::string &config);
+std::string compileRequest(const std::map<std::string, wsp::workbranch *> &branches, std::string &&request);
 
 int main()
 {
     std::cout << getCurrentTime() << "Hello JudgeCompile!" << endl;
 
-    RabbitMQPull mqWorker;
+    signal(SIGTERM, [](int)
+           { stopping = true; });
+    signal(SIGINT, [](int)
+           { stopping = true; });
+
+    // 传输层配置
+    std::string transport = getSetting("TRANSPORT", TRANSPORT);
+    MemoryResultSink memorySink("CompileQueueOutput");
+    ResultSink &sink = transport == "amqp" ? static_cast<ResultSink &>(RabbitMQPushPool::instance()) : memorySink;
+    std::unique_ptr<UnixSocketBroker> socketBroker;
+    if (transport == "unix")
+        socketBroker.reset(new UnixSocketBroker(getSetting("UNIX_SOCKET_PATH", UNIX_SOCKET_PATH)));
+    if (transport != "amqp")
+        preloadTasks(getSetting("TRANSPORT_INPUT", TRANSPORT_INPUT));
+    cout << getCurrentTime() << "Transport: " << transport << endl;
+
+    ResultPublisher publisher(sink);
+    // 取消通道仅在 AMQP 下可用
+    std::unique_ptr<ControlListener> control;
+    if (transport == "amqp")
+        control.reset(new ControlListener);
 
-    // 线程池配置
     wsp::workspace spc;
-    auto brh_id = spc.attach(new wsp::workbranch);
-    // 最小线程数 最大线程数 时间间隔
-    auto spv_id = spc.attach(new wsp::supervisor(10, 100, 1000));
-    spc[spv_id].supervise(spc[brh_id]);
+    std::vector<std::thread> consumerThreads;
+    std::map<std::string, wsp::workbranch *> branches; // 语言 -> 线程池，"" 为共享线程池
+
+    auto shards = languageShards(getSetting("LANGUAGE_SHARDS", LANGUAGE_SHARDS));
+    if (shards.empty())
+    {
+        // 线程池配置
+        auto brh_id = spc.attach(new wsp::workbranch);
+        // 最小线程数 最大线程数 时间间隔
+        auto spv_id = spc.attach(new wsp::supervisor(WORKER_MIN_THREADS, WORKER_MAX_THREADS, 1000));
+        spc[spv_id].supervise(spc[brh_id]);
+        branches[""] = &spc[brh_id];
+
+        // 消费线程配置，预取窗口由各线程均分
+        int consumers = std::max(1, getSetting("MQ_CONSUMER_THREADS", MQ_CONSUMER_THREADS));
+        int prefetch = std::max(1, MQ_PREFETCH_COUNT / consumers);
+        for (int i = 0; i < consumers; i++)
+            consumerThreads.emplace_back(consume_loop, std::ref(spc[brh_id]), std::ref(publisher),
+                                         sourceFactory(transport, laneSubscriptions(prefetch)));
+
+        cout << getCurrentTime() << "Start to Listen with " << consumers << " consumers!" << endl;
+    }
+    else
+    {
+        // 按语言分片：每种语言独立的线程池（固定并发）与消费者，预取窗口等于并发上限
+        for (auto &[language, concurrency] : shards)
+        {
+            auto brh_id = spc.attach(new wsp::workbranch(concurrency));
+            branches[language] = &spc[brh_id];
+            std::vector<QueueSubscription> subscriptions = {
+                {"CompileQueueInput.lang." + language, language, (uint16_t)concurrency}};
+            consumerThreads.emplace_back(consume_loop, std::ref(spc[brh_id]), std::ref(publisher),
+                                         sourceFactory(transport, subscriptions));
+
+            cout << getCurrentTime() << "Start to Listen " << language << " with concurrency " << concurrency << "!" << endl;
+        }
+    }
+
+    // 同步编译接口，与消费线程共享线程池
+    std::unique_ptr<CompileServer> server;
+    std::string socketPath = getSetting("COMPILE_SOCKET_PATH", COMPILE_SOCKET_PATH);
+    if (!socketPath.empty())
+    {
+        try
+        {
+            fs::create_directories(fs::path(socketPath).parent_path());
+            server.reset(new CompileServer(socketPath, [&branches](std::string &&request)
+                                           { return compileRequest(branches, std::move(request)); }));
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << getCurrentTime() << "Compile API disabled: " << e.what() << std::endl;
+        }
+    }
+
+    // 交接模式：等待所有消费线程就绪（连接可能仍在退避重试），再通知旧进程退出
+    pid_t previous = handoffPidFile();
+    if (previous > 0 && getSetting("HANDOFF", HANDOFF))
+    {
+        while (!stopping && readyConsumers < (int)consumerThreads.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(MQ_ACK_INTERVAL));
+        if (!stopping)
+        {
+            cout << getCurrentTime() << "Handoff from process " << previous << endl;
+            kill(previous, SIGTERM);
+        }
+    }
+
+    auto lastReport = std::chrono::steady_clock::now();
+    while (!stopping)
+    { // 定期输出指标，清理过期的任务索引、产物、共享内存段与附加文件缓存
+        std::this_thread::sleep_for(std::chrono::milliseconds(MQ_CONSUME_TIMEOUT));
+        if (std::chrono::steady_clock::now() - lastReport < std::chrono::seconds(METRICS_INTERVAL))
+            continue;
+        Metrics::report(cout);
+        TaskIndex::instance().expire();
+        ArtifactStore::instance().expire();
+        ArtifactRing::instance().expire(publisher.lastDeferred());
+        AssetCache::instance().expire();
+        lastReport = std::chrono::steady_clock::now();
+    }
+
+    // 平滑退出：消费线程停止消费，并等待已拉取的任务完成、回送、确认
+    cout << getCurrentTime() << "Draining..." << endl;
+    server.reset();
+    for (auto &thread : consumerThreads)
+        thread.join();
+    Metrics::report(cout);
+
+    // 仅在 PID 文件仍指向本进程时删除
+    fs::path pidFile = fs::path(FILE_ROOT_PATH) / PID_FILE;
+    std::ifstream pidIn(pidFile.string());
+    pid_t recorded = 0;
+    if (pidIn >> recorded && recorded == getpid())
+        fs::remove(pidFile);
+
+    cout << getCurrentTime() << "Bye JudgeCompile!" << endl;
+    return 0;
+}
+
+/**
+ * @brief 进程的可执行文件名；升级后旧进程的 exe 带有 " (deleted)" 后缀，一并去掉
+ * @return 进程不存在或无权读取时为空
+ */
+std::string executableName(pid_t pid)
+{
+    char buffer[PATH_MAX];
+    ssize_t length = readlink(("/proc/" + std::to_string(pid) + "/exe").c_str(), buffer, sizeof(buffer) - 1);
+    if (length <= 0)
+        return "";
+    std::string path(buffer, length);
+    const std::string deleted = " (deleted)";
+    if (path.size() > deleted.size() && path.compare(path.size() - deleted.size(), deleted.size(), deleted) == 0)
+        path.resize(path.size() - deleted.size());
+    return fs::path(path).filename().string();
+}
+
+/**
+ * @brief 读取旧进程 PID 并写入本进程 PID
+ * 崩溃或重启后 PID 可能已被无关进程复用，只有可执行文件名与本进程相同时才视为旧进程
+ * @return 旧进程 PID，不存在、已退出或不是本程序时返回 0
+ */
+pid_t handoffPidFile()
+{
+    fs::path pidFile = fs::path(FILE_ROOT_PATH) / PID_FILE;
+    fs::create_directories(pidFile.parent_path());
+
+    pid_t previous = 0;
+    std::ifstream in(pidFile.string());
+    if (!(in >> previous) || previous == getpid() || kill(previous, 0) != 0 ||
+        executableName(previous) != executableName(getpid()))
+        previous = 0;
+    in.close();
+
+    fs::path tmp = pidFile;
+    tmp += ".tmp";
+    std::ofstream out(tmp.string());
+    out << getpid() << std::endl;
+    out.close();
+    fs::rename(tmp, pidFile);
+    return previous;
+}
+
+/**
+ * @brief 按通道权重划分预取窗口（竞争时的保底份额，空闲通道的份额由 RabbitMQPull 借给活跃通道）
+ * @param prefetch 单个消费线程的预取窗口总量
+ * @return 按优先级排列的订阅列表
+ */
+std::vector<QueueSubscription> laneSubscriptions(int prefetch)
+{
+    auto share = [prefetch](int weight)
+    { return (uint16_t)std::max(1, prefetch * weight / 100); };
+
+    std::vector<QueueSubscription> subscriptions;
+    subscriptions.push_back({"CompileQueueInput.contest", "contest", share(getSetting("LANE_WEIGHT_CONTEST", LANE_WEIGHT_CONTEST))});
+
+    // 题目亲和队列优先于共享队列消费，与共享队列平分 practice 通道的权重，各通道份额之和不超出预取窗口
+    int practice = getSetting("LANE_WEIGHT_PRACTICE", LANE_WEIGHT_PRACTICE);
+    std::string nodeID = getSetting("AFFINITY_NODE_ID", AFFINITY_NODE_ID);
+    if (!nodeID.empty())
+    {
+        QueueSubscription affinity{"CompileQueueInput.node." + nodeID, "practice", share(practice - practice / 2)};
+        practice /= 2;
+        // 超出长度上限时拒收新任务，滞留超过 TTL（如节点宕机）的任务过期；两者均经死信转投共享队列
+        affinity.arguments["x-max-length"] = (int32_t)getSetting("AFFINITY_QUEUE_LENGTH", AFFINITY_QUEUE_LENGTH);
+        affinity.arguments["x-overflow"] = "reject-publish-dlx";
+        affinity.arguments["x-message-ttl"] = (int32_t)getSetting("AFFINITY_QUEUE_TTL", AFFINITY_QUEUE_TTL);
+        affinity.arguments["x-dead-letter-exchange"] = "";
+        affinity.arguments["x-dead-letter-routing-key"] = "CompileQueueInput";
+        affinity.exchange = AFFINITY_EXCHANGE;
+        affinity.exchange_type = "x-consistent-hash";
+        affinity.binding_key = "1"; // 哈希环上的权重，各节点相同
+        subscriptions.push_back(affinity);
+    }
+
+    subscriptions.push_back({"CompileQueueInput", "practice", share(practice)});
+    subscriptions.push_back({"CompileQueueInput.rejudge", "rejudge", share(getSetting("LANE_WEIGHT_REJUDGE", LANE_WEIGHT_REJUDGE))});
+    return subscriptions;
+}
+
+/**
+ * @brief 解析语言分片配置
+ * @param config 形如 "C++:16,Java:2"
+ * @return (语言, 并发上限) 列表，配置为空时返回空列表
+ */
+std::vector<std::pair<std::string, int>> languageShards(const std::string &config)
+{
+    std::vector<std::pair<std::string, int>> shards;
+    std::stringstream ss(config);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        size_t pos = item.find_last_of(':');
+        if (item.empty() || pos == std::string::npos)
+            continue;
+        try
+        {
+            shards.emplace_back(item.substr(0, pos), std::max(1, std::stoi(item.substr(pos + 1))));
+        }
+        catch (const std::exception &)
+        {
+            std::cerr << getCurrentTime() << "Invalid language shard: " << item << std::endl;
+        }
+    }
+    return shards;
+}
+
+/**
+ * @brief 按传输层创建任务来源
+ * @param transport "amqp" / "memory" / "unix"
+ * @param subscriptions 订阅的输入队列；非 AMQP 传输只使用队列名与通道
+ */
+SourceFactory sourceFactory(const std::string &transport, const std::vector<QueueSubscription> &subscriptions)
+{
+    if (transport == "amqp")
+        return [subscriptions]
+        { return std::unique_ptr<TaskSource>(new RabbitMQPull(subscriptions, stopping)); };
+
+    std::vector<std::pair<std::string, std::string>> queues;
+    for (auto &sub : subscriptions)
+        queues.emplace_back(sub.queue, sub.lane);
+    return [queues]
+    { return std::unique_ptr<TaskSource>(new MemoryTaskSource(queues)); };
+}
+
+/**
+ * @brief 把任务文件预载到进程内输入队列，用于脱离 broker 压测
+ * @param path 每行一条 JSON 任务，为空时跳过
+ */
+void preloadTasks(const std::string &path)
+{
+    if (path.empty())
+        return;
+    std::ifstream in(path);
+    std::string line;
+    int count = 0;
+    while (std::getline(in, line))
+    {
+        if (line.empty())
+            continue;
+        MemoryBroker::instance().publish("CompileQueueInput", line, MemoryBroker::Overflow::UNBOUNDED);
+        count++;
+    }
+    cout << getCurrentTime() << "Preloaded " << count << " tasks from " << path << endl;
+}
+
+/**
+ * @brief 处理同步编译接口的一条请求：交给对应语言的线程池执行并等待结果
+ * @param branches 语言 -> 线程池，"" 为共享线程池
+ * @param request 任务 JSON
+ * @return 结果 JSON；请求无法处理时为 {"error": 原因}
+ */
+std::string compileRequest(const std::map<std::string, wsp::workbranch *> &branches, std::string &&request)
+{
+    auto taskData = std::make_shared<json>();
+    wsp::workbranch *branch = nullptr;
+    std::string taskID, fingerprint;
+    try
+    {
+        *taskData = json::parse(request);
+        taskID = (*taskData)["task"]["id"];
+        fingerprint = TaskIndex::fingerprint(*taskData);
+        auto it = branches.find("");
+        if (it == branches.end())
+            it = branches.find((*taskData)["task"]["answer"]["language"].get<std::string>());
+        if (it == branches.end())
+            return json{{"error", "Unsupported language"}}.dump();
+        branch = it->second;
+    }
+    catch (const json::exception &e)
+    {
+        return json{{"error", std::string("Malformed task: ") + e.what()}}.dump();
+    }
 
-    cout << getCurrentTime() << "Start to Listen!" << endl;
+    // 与 broker 任务共用任务 ID 空间：同 ID 任务正在处理时拒绝，避免争用任务目录
+    if (!TaskIndex::instance().claim(taskID, fingerprint))
+        return json{{"error", "Task already running"}}.dump();
+    CancelRegistry::instance().admit(taskID, std::chrono::steady_clock::now());
 
-    while (true)
+    // 调用方同步等待，插队到线程池队首；任何异常都转为错误应答，promise 总会被兑现
+    auto done = std::make_shared<std::promise<std::string>>();
+    auto result = done->get_future();
+    branch->submit<wsp::task::urg>([taskData, done]
+                                   {
+        try
+        {
+            if (work_func(*taskData))
+                done->set_value(taskData->dump());
+            else
+                done->set_value(json{{"error", "Unsupported language"}}.dump());
+        }
+        catch (const json::exception &e)
+        {
+            done->set_value(json{{"error", std::string("Malformed task: ") + e.what()}}.dump());
+        }
+        catch (const std::exception &e)
+        {
+            done->set_value(json{{"error", e.what()}}.dump());
+        }
+        catch (...)
+        {
+            done->set_value(json{{"error", "Unknown Error"}}.dump());
+        } });
+    Metrics::counter("compile_server.request").add();
+
+    std::string response;
+    try
+    {
+        response = result.get();
+    }
+    catch (const std::exception &e)
+    { // 任务未执行（线程池已销毁）
+        response = json{{"error", e.what()}}.dump();
+    }
+    // 结果只交给了调用方，不记为已回送；期间推迟的同 ID broker 投递随即重新处理
+    TaskIndex::instance().abandon(taskID);
+    return response;
+}
+
+/**
+ * @brief 把一条消息交给工作线程处理
+ * 与进行中的同 ID 任务冲突而被推迟的消息，在该任务结束后以同一 message 再次调用
+ */
+void dispatch(wsp::workbranch &branch, std::shared_ptr<TaskMessage> message, TaskSource &mqWorker,
+              ResultPublisher &publisher)
+{
+    bool urgent = message->lane == "contest" || !message->reply.empty();
+    auto task = [message, &branch, &mqWorker, &publisher]
     {
+        // 线程池中的排队时长
+        Metrics::timer("lane." + message->lane + ".pool_wait").record(Metrics::elapsedUs(message->received));
+        const Delivery &delivery = message->delivery;
+
         json taskData;
+        std::string taskID, fingerprint;
         try
         {
-            if (!mqWorker.pullTaskData(taskData))
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                continue;
-            }
+            if (message->contentEncoding == "gzip")
+                taskData = MessageCodec::decode(Compression::gunzip(message->body), message->contentType);
+            else
+                taskData = MessageCodec::decode(message->body, message->contentType);
+            taskID = taskData["task"]["id"];
+            fingerprint = TaskIndex::fingerprint(taskData);
+        }
+        catch (const std::exception &e)
+        { // 任务格式错误，重试无意义，直接确认丢弃
+            std::cerr << getCurrentTime() << "Drop malformed task: " << e.what() << std::endl;
+            mqWorker.ack(delivery);
+            return;
+        }
+
+        // 重复投递：内容相同且结果已回送的直接确认，进行中的挂起等待；
+        // 重判、交互式请求（调用方等待应答）与内容不同的总是重新处理，同 ID 任务进行中时推迟到其结束后
+        bool reuse = message->lane != "rejudge" && message->reply.empty();
+        auto retry = [&branch, message, &mqWorker, &publisher]
+        { dispatch(branch, message, mqWorker, publisher); };
+        switch (TaskIndex::instance().begin(taskID, fingerprint, reuse, !message->reply.empty(), &mqWorker,
+                                            delivery, retry))
+        {
+        case TaskIndex::State::DONE:
+            std::cout << getCurrentTime() << "Duplicate Task: " << taskID << endl;
+            mqWorker.ack(delivery);
+            return;
+        case TaskIndex::State::ATTACHED:
+            std::cout << getCurrentTime() << "Attach to running Task: " << taskID << endl;
+            return;
+        case TaskIndex::State::DEFERRED:
+            std::cout << getCurrentTime() << "Defer until running Task finishes: " << taskID << endl;
+            return;
+        case TaskIndex::State::STARTED:
+            CancelRegistry::instance().admit(taskID, message->received);
+            break;
         }
-        catch (const AmqpClient::ChannelException &e)
+
+        bool publish = false;
+        try
         {
-            cout << e.what() << endl;
+            publish = work_func(taskData, MessageCodec::format(message->contentType) != MessageCodec::Format::JSON);
+        }
+        catch (const json::exception &e)
+        { // 任务格式错误，重试无意义，直接确认丢弃
+            std::cerr << getCurrentTime() << "Drop malformed task: " << e.what() << std::endl;
+        }
+        if (!publish)
+        { // 无需回送结果，连同挂起的重复投递一并确认
+            mqWorker.ack(delivery);
+            for (auto &[source, waiter] : TaskIndex::instance().abandon(taskID))
+                source->ack(waiter);
+            return;
+        }
+        // 交由回送线程推送，工作线程立即释放；交互式请求直接回送到应答队列
+        publisher.submit(std::move(taskData), &mqWorker, delivery, message->reply, message->contentType);
+    };
+
+    // 提交工作线程，contest 任务与交互式请求插队到线程池队首
+    if (urgent)
+        branch.submit<wsp::task::urg>(task);
+    else
+        branch.submit(task);
+}
+
+/**
+ * @brief 消费线程：独占一个任务来源拉取原始消息，解析交由工作线程完成
+ */
+void consume_loop(wsp::workbranch &branch, ResultPublisher &publisher, SourceFactory makeSource)
+{
+    std::unique_ptr<TaskSource> source = makeSource(); // 返回时已连接并注册消费者（退出期间可能未连接）
+    TaskSource &mqWorker = *source;
+    readyConsumers++;
+
+    while (!stopping)
+    {
+        // 阻塞等待消息，超时后重新进入循环；连接异常在内部重连
+        TaskMessage message;
+        if (!mqWorker.pullTaskData(message))
             continue;
+
+        // broker 中的排队时长（timestamp 精度为秒）
+        if (message.timestamp > 0)
+        {
+            int64_t waited = std::time(nullptr) - (int64_t)message.timestamp;
+            Metrics::summary("lane." + message.lane + ".broker_wait_s").record(std::max<int64_t>(0, waited));
         }
 
-        // 提交工作线程
-        spc.submit([taskData]
-                   {
-            // 值传递，生成副本，避免循环继续使得生命周期结束
-            work_func(taskData); });
+        dispatch(branch, std::make_shared<TaskMessage>(std::move(message)), mqWorker, publisher);
+    }
+
+    // 停止消费，等待已拉取的任务确认
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(getSetting("DRAIN_TIMEOUT", DRAIN_TIMEOUT));
+    if (!mqWorker.drain(deadline))
+    { // 仍有任务未完成，直接退出，未确认的任务由 broker 重新投递
+        std::cerr << getCurrentTime() << "Drain timeout, exit now" << std::endl;
+        std::_Exit(1);
     }
 }
 
-void work_func(json taskData)
+/**
+ * @brief 处理单个任务，结果写回 taskData
+ * @param binary 产物以原始字节写回（二进制封装）
+ * @return 是否需要回送结果
+ */
+bool work_func(json &taskData, bool binary)
 {
     CompileInterface *compileImpl = nullptr;
 
     std::string taskID = taskData["task"]["id"];
     std::cout << getCurrentTime() << "Deal with Task: " << taskID << endl;
 
-    // 取出taskData.task.answer.language
-    std::string language = taskData["task"]["answer"]["language"];
-    // 根据language字段选择对应的编译实例
-    if (language == "C")
-        compileImpl = new CCompile(taskData);
-    else if (language == "C++")
-        compileImpl = new CppCompile(taskData);
-    else if (language == "Java")
-        compileImpl = new JavaCompile(taskData);
-    else if (language == "Python")
-        compileImpl = new PythonCompile(taskData);
-    else if (language == "Verilog")
-        compileImpl = new VerilogCompile(taskData);
-    else if (language == "Lua")
-        compileImpl = new LuaCompile(taskData);
-    else
+    // 排队期间已被取消
+    if (CancelRegistry::instance().isCancelled(taskID))
     {
-        std::cerr << getCurrentTime() << "Unsupported language: " << language << std::endl;
-        return;
+        std::cout << getCurrentTime() << "Skip cancelled Task: " << taskID << endl;
+        failTask(taskData, "CANCELLED", "cancelled");
+        return true;
     }
 
-    std::cout << getCurrentTime() << "Work with Task: " << taskID << endl;
+    // 取出taskData.task.answer.language
+    std::string language = taskData["task"]["answer"]["language"];
     try
     {
-        compileImpl->save();
-        compileImpl->compile();
+        // 根据language字段选择对应的编译实例
+        if (language == "C")
+            compileImpl = new CCompile(taskData);
+        else if (language == "C++")
+            compileImpl = new CppCompile(taskData);
+        else if (language == "Java")
+            compileImpl = new JavaCompile(taskData);
+        else if (language == "Python")
+            compileImpl = new PythonCompile(taskData);
+        else if (language == "Verilog")
+            compileImpl = new VerilogCompile(taskData);
+        else if (language == "Lua")
+            compileImpl = new LuaCompile(taskData);
+        else
+        {
+            std::cerr << getCurrentTime() << "Unsupported language: " << language << std::endl;
+            return false;
+        }
+
+        std::cout << getCurrentTime() << "Work with Task: " << taskID << endl;
+        CancelRegistry::instance().attach(taskID, compileImpl);
+        compileImpl->setBinary(binary);
+
+        // 编译缓存命中时跳过保存与编译，缓存的产物已放入任务目录
+        fs::path taskDir = FILE_ROOT_PATH + taskID;
+        std::string cacheKey = CompileCache::key(taskData, compileImpl->signature());
+        if (cacheKey.empty() || !CompileCache::instance().restore(cacheKey, taskDir))
+        {
+            compileImpl->save();
+            compileImpl->checkCancelled();
+            compileImpl->compile();
+            compileImpl->checkCancelled();
+            if (!cacheKey.empty())
+                CompileCache::instance().store(cacheKey, taskDir);
+        }
         compileImpl->transcode();
     }
+    catch (task_cancelled &e)
+    { // 任务已取消
+        failTask(taskData, "CANCELLED", e.what());
+        std::cerr << "任务已取消: " << taskID << std::endl;
+    }
+    catch (assets_missing &e)
+    { // 引用的附加文件不在缓存中，由上游内联补发
+        failTask(taskData, "MISSING_ASSETS", e.what());
+        taskData["task"]["result"]["missing"] = e.hashes;
+        std::cerr << "缺少附加文件: " << e.hashes.size() << std::endl;
+    }
     catch (compile_error &e)
     { // 编译错误
-        taskData["task"]["status"] = "CE";
-        taskData["task"]["result"].clear();
-        taskData["task"]["result"]["msg"] = e.what();
+        failTask(taskData, "CE", e.what());
         std::cerr << "编译错误: " << e.what() << std::endl;
     }
     catch (std::runtime_error &e)
     { // 运行时错误
-        taskData["task"]["status"] = "RE";
-        taskData["task"]["result"].clear();
-        taskData["task"]["result"]["msg"] = e.what();
+        failTask(taskData, "RE", e.what());
         std::cerr << "运行时异常: " << e.what() << std::endl;
     }
     catch (const std::string &msg)
     { // 按未知错误处理
-        taskData["task"]["status"] = "UKE";
-        taskData["task"]["result"].clear();
-        taskData["task"]["result"]["msg"] = msg;
+        failTask(taskData, "UKE", msg);
         std::cerr << "字符串异常: " << msg << std::endl;
     }
     catch (const std::exception &e)
     { // 按未知错误处理
-        taskData["task"]["status"] = "UKE";
-        taskData["task"]["result"].clear();
-        taskData["task"]["result"]["msg"] = e.what();
+        failTask(taskData, "UKE", e.what());
         std::cerr << "标准异常: " << e.what() << std::endl;
     }
     catch (...)
     { // 未知错误
-        taskData["task"]["status"] = "UKE";
-        taskData["task"]["result"].clear();
-        taskData["task"]["result"]["msg"] = "Unknown Error";
+        failTask(taskData, "UKE", "Unknown Error");
         std::cerr << "Unknown Error" << std::endl;
     }
 
-    std::cout << getCurrentTime() << "Push back task: " << taskID << endl;
-
-    // 回送TaskData
-    RabbitMQPush mqWorker;
-    mqWorker.pushTaskData(taskData);
-
-    std::cout << getCurrentTime() << "Finish Task: " << taskID << endl;
     // 释放指针
+    CancelRegistry::instance().detach(taskID);
     delete compileImpl;
+
+    std::cout << getCurrentTime() << "Finish Task: " << taskID << endl;
+    return true;
+}
+
+/**
+ * @brief 以错误状态结束任务：清空已写入的产物及其哈希，写入错误信息
+ * @param status 任务状态
+ * @param msg 错误信息
+ */
+void failTask(json &taskData, const std::string &status, const std::string &msg)
+{
+    taskData["task"]["status"] = status;
+    // transcode() 中途失败时 result 已是数组，clear() 保留类型，需重新赋为对象
+    taskData["task"]["result"] = json::object();
+    taskData["task"].erase("resultMeta");
+    taskData["task"]["result"]["msg"] = msg;
 }
\ No newline at end of file